@@ -2,8 +2,7 @@
 #include <iostream>
 #include <sstream>
 #include <vector>
-#include "scanner.hpp"
-#include "parser.hpp"
+#include "compiler.hpp"
 
 using namespace std;
 
@@ -26,11 +25,11 @@ void processFile(const string& filePath) {
 
     if (!fileContent.empty()) {
         cout << "Processing file: " << filePath << endl;
-        Scanner scanner(fileContent);
-        vector<Token> tokens = scanner.scanTokens();
-
-        Parser parser(tokens);
-        bool success = parser.parse();
+        // Syntax-only: declarations are not required and no code is generated.
+        string diagnostics;
+        Bytecode bytecode;
+        bool success = compileSource(fileContent.data(), fileContent.size(), ParseMode::SyntaxOnly, diagnostics, bytecode);
+        cerr << diagnostics;
 
         if (success) {
             cout << "Success! Parsing completed successfully for file " << filePath << endl;
@@ -0,0 +1,455 @@
+#include "batchio.hpp"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <stdexcept>
+#include <iostream>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <atomic>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+namespace {
+
+const size_t initialReadSize = 16 * 1024;
+
+bool readWholeFile(const string& path, string& content) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    size_t done = 0;
+    content.resize(initialReadSize);
+    while (true) {
+        if (done == content.size()) content.resize(content.size() * 2);
+        ssize_t n = pread(fd, &content[done], content.size() - done, done);
+        if (n < 0) {
+            close(fd);
+            return false;
+        }
+        if (n == 0) break;
+        done += n;
+    }
+    content.resize(done);
+    close(fd);
+    return true;
+}
+
+// Returns 0, or the errno of the open or write that failed.
+int writeWholeFile(const string& path, const string& content) {
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return errno;
+    size_t done = 0;
+    while (done < content.size()) {
+        ssize_t n = pwrite(fd, content.data() + done, content.size() - done, done);
+        if (n <= 0) {
+            int error = n < 0 ? errno : EIO;
+            close(fd);
+            return error;
+        }
+        done += n;
+    }
+    if (close(fd) < 0) return errno;
+    return 0;
+}
+
+// Fallback: one I/O thread works through the queued reads and writes in
+// submission order while the caller compiles.
+class ThreadedFileBatch : public FileBatch {
+public:
+    ThreadedFileBatch() : worker(&ThreadedFileBatch::work, this) {}
+
+    ~ThreadedFileBatch() override {
+        {
+            lock_guard<mutex> lock(guard);
+            stopping = true;
+        }
+        wake.notify_all();
+        worker.join();
+    }
+
+    const char* name() const override { return "threaded"; }
+
+    void prefetch(const string& path) override {
+        auto read = make_shared<Job>();
+        read->path = path;
+        read->isWrite = false;
+        {
+            lock_guard<mutex> lock(guard);
+            jobs.push_back(read);
+            reads.push_back(read);
+        }
+        wake.notify_all();
+    }
+
+    BatchRead next() override {
+        unique_lock<mutex> lock(guard);
+        shared_ptr<Job> read = reads.front();
+        reads.pop_front();
+        done.wait(lock, [&] { return read->finished; });
+        return {read->path, move(read->content), read->ok};
+    }
+
+    void write(const string& path, string content) override {
+        auto job = make_shared<Job>();
+        job->path = path;
+        job->content = move(content);
+        job->isWrite = true;
+        {
+            lock_guard<mutex> lock(guard);
+            jobs.push_back(job);
+        }
+        wake.notify_all();
+    }
+
+    vector<BatchWriteError> flush() override {
+        unique_lock<mutex> lock(guard);
+        done.wait(lock, [&] { return jobs.empty() && !busy; });
+        return move(failedWrites);
+    }
+
+private:
+    struct Job {
+        string path;
+        string content;
+        bool isWrite = false;
+        bool ok = false;
+        bool finished = false;
+    };
+
+    mutex guard;
+    condition_variable wake;
+    condition_variable done;
+    deque<shared_ptr<Job>> jobs;
+    deque<shared_ptr<Job>> reads;
+    vector<BatchWriteError> failedWrites;
+    bool busy = false;
+    bool stopping = false;
+    thread worker;
+
+    void work() {
+        unique_lock<mutex> lock(guard);
+        while (true) {
+            wake.wait(lock, [&] { return stopping || !jobs.empty(); });
+            if (jobs.empty()) return;
+            shared_ptr<Job> job = jobs.front();
+            jobs.pop_front();
+            busy = true;
+            lock.unlock();
+
+            int writeError = 0;
+            if (job->isWrite) {
+                writeError = writeWholeFile(job->path, job->content);
+            } else {
+                job->ok = readWholeFile(job->path, job->content);
+            }
+
+            lock.lock();
+            if (writeError != 0) failedWrites.push_back({job->path, writeError});
+            job->finished = true;
+            busy = false;
+            done.notify_all();
+        }
+    }
+};
+
+#ifdef __linux__
+
+// io_uring through the raw system calls, so liburing is not required. Every
+// file goes through an open -> read/write -> close sequence of requests; the
+// next step of a file is queued from the completion of the previous one, and
+// all queued requests go to the kernel in a single io_uring_enter call.
+class UringFileBatch : public FileBatch {
+public:
+    static unique_ptr<FileBatch> create() {
+        unique_ptr<UringFileBatch> batch(new UringFileBatch());
+        if (!batch->setup()) return nullptr;
+        return batch;
+    }
+
+    ~UringFileBatch() override {
+        if (ringFd >= 0) {
+            // flush() can throw, which must not escape a destructor; callers
+            // that want to see write errors call flush() themselves.
+            try {
+                for (const auto& failure : flush()) {
+                    cerr << "Could not write " << failure.path << ": " << strerror(failure.error) << endl;
+                }
+            } catch (const runtime_error& error) {
+                cerr << "Batch I/O error while closing: " << error.what() << endl;
+            }
+            if (sqes != MAP_FAILED) munmap(sqes, sqesSize);
+            if (cqRing != MAP_FAILED && cqRing != sqRing) munmap(cqRing, cqRingSize);
+            if (sqRing != MAP_FAILED) munmap(sqRing, sqRingSize);
+            close(ringFd);
+        }
+    }
+
+    const char* name() const override { return "io_uring"; }
+
+    void prefetch(const string& path) override {
+        auto op = make_unique<Operation>();
+        op->path = path;
+        op->stage = Stage::OpenRead;
+        submitOpen(op.get(), O_RDONLY);
+        reads.push_back(move(op));
+    }
+
+    BatchRead next() override {
+        Operation* op = reads.front().get();
+        while (!op->finished) reap(1);
+        BatchRead result = {op->path, move(op->buffer), op->ok};
+        reads.pop_front();
+        return result;
+    }
+
+    void write(const string& path, string content) override {
+        auto op = make_unique<Operation>();
+        op->path = path;
+        op->buffer = move(content);
+        op->stage = Stage::OpenWrite;
+        submitOpen(op.get(), O_WRONLY | O_CREAT | O_TRUNC);
+        writes.emplace(op.get(), move(op));
+    }
+
+    vector<BatchWriteError> flush() override {
+        while (inFlight > 0 || pending > 0) reap(1);
+        return move(failedWrites);
+    }
+
+private:
+    enum class Stage { OpenRead, Read, OpenWrite, Write };
+
+    struct Operation {
+        Stage stage;
+        string path;
+        string buffer;
+        size_t done = 0;
+        int fd = -1;
+        bool ok = false;
+        bool finished = false;
+    };
+
+    static const unsigned entries = 256;
+
+    int ringFd = -1;
+    void* sqRing = MAP_FAILED;
+    void* cqRing = MAP_FAILED;
+    void* sqes = MAP_FAILED;
+    size_t sqRingSize = 0;
+    size_t cqRingSize = 0;
+    size_t sqesSize = 0;
+
+    unsigned* sqHead = nullptr;
+    unsigned* sqTail = nullptr;
+    unsigned* sqMask = nullptr;
+    unsigned* sqArray = nullptr;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned* cqMask = nullptr;
+    io_uring_cqe* cqes = nullptr;
+
+    unsigned pending = 0;
+    size_t inFlight = 0;
+    deque<unique_ptr<Operation>> reads;
+    unordered_map<Operation*, unique_ptr<Operation>> writes;
+    vector<BatchWriteError> failedWrites;
+
+    UringFileBatch() {}
+
+    static unsigned load(unsigned* p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+    static void store(unsigned* p, unsigned v) { __atomic_store_n(p, v, __ATOMIC_RELEASE); }
+
+    bool setup() {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        ringFd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (ringFd < 0) return false;
+
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        if (params.features & IORING_FEAT_SINGLE_MMAP) {
+            sqRingSize = cqRingSize = max(sqRingSize, cqRingSize);
+        }
+        sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+        if (sqRing == MAP_FAILED) return false;
+        if (params.features & IORING_FEAT_SINGLE_MMAP) {
+            cqRing = sqRing;
+        } else {
+            cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+            if (cqRing == MAP_FAILED) return false;
+        }
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) return false;
+
+        char* sq = static_cast<char*>(sqRing);
+        char* cq = static_cast<char*>(cqRing);
+        sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        return supportsFileOperations();
+    }
+
+    // OPENAT, READ, WRITE and CLOSE arrived in different kernel releases.
+    bool supportsFileOperations() {
+        size_t size = sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op);
+        unique_ptr<char[]> storage(new char[size]());
+        io_uring_probe* probe = reinterpret_cast<io_uring_probe*>(storage.get());
+        if (syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_PROBE, probe, 256) < 0) return false;
+        for (int op : {IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_WRITE, IORING_OP_CLOSE}) {
+            if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) return false;
+        }
+        return true;
+    }
+
+    io_uring_sqe* nextSqe() {
+        unsigned tail = *sqTail;
+        while (tail - load(sqHead) >= entries || inFlight + pending >= entries) {
+            reap(1);
+            tail = *sqTail;
+        }
+        unsigned index = tail & *sqMask;
+        io_uring_sqe* sqe = static_cast<io_uring_sqe*>(sqes) + index;
+        memset(sqe, 0, sizeof(*sqe));
+        sqArray[index] = index;
+        store(sqTail, tail + 1);
+        pending++;
+        return sqe;
+    }
+
+    void submitOpen(Operation* op, int flags) {
+        io_uring_sqe* sqe = nextSqe();
+        sqe->opcode = IORING_OP_OPENAT;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = reinterpret_cast<uint64_t>(op->path.c_str());
+        sqe->len = 0644;
+        sqe->open_flags = flags;
+        sqe->user_data = reinterpret_cast<uint64_t>(op);
+    }
+
+    void submitTransfer(Operation* op) {
+        io_uring_sqe* sqe = nextSqe();
+        if (op->stage == Stage::Read) {
+            if (op->done == op->buffer.size()) op->buffer.resize(max(initialReadSize, op->buffer.size() * 2));
+            sqe->opcode = IORING_OP_READ;
+            sqe->addr = reinterpret_cast<uint64_t>(&op->buffer[op->done]);
+        } else {
+            sqe->opcode = IORING_OP_WRITE;
+            sqe->addr = reinterpret_cast<uint64_t>(op->buffer.data() + op->done);
+        }
+        sqe->fd = op->fd;
+        sqe->len = static_cast<unsigned>(op->buffer.size() - op->done);
+        sqe->off = op->done;
+        sqe->user_data = reinterpret_cast<uint64_t>(op);
+    }
+
+    // Closes are fire-and-forget: their completion carries no operation.
+    void submitClose(int fd) {
+        io_uring_sqe* sqe = nextSqe();
+        sqe->opcode = IORING_OP_CLOSE;
+        sqe->fd = fd;
+        sqe->user_data = 0;
+    }
+
+    void reap(unsigned waitFor) {
+        unsigned submitted = pending;
+        if (syscall(__NR_io_uring_enter, ringFd, submitted, waitFor, IORING_ENTER_GETEVENTS, nullptr, 0) < 0) {
+            throw runtime_error(string("io_uring_enter failed: ") + strerror(errno));
+        }
+        inFlight += submitted;
+        pending = 0;
+
+        unsigned head = *cqHead;
+        unsigned tail = load(cqTail);
+        vector<pair<Operation*, int>> completions;
+        for (; head != tail; head++) {
+            const io_uring_cqe& cqe = cqes[head & *cqMask];
+            completions.push_back({reinterpret_cast<Operation*>(cqe.user_data), cqe.res});
+        }
+        store(cqHead, head);
+        inFlight -= completions.size();
+
+        for (const auto& completion : completions) {
+            if (completion.first != nullptr) advance(completion.first, completion.second);
+        }
+    }
+
+    // error is the errno of a failed request, or 0.
+    void finish(Operation* op, int error) {
+        op->ok = error == 0;
+        op->finished = true;
+        if (op->stage == Stage::OpenRead || op->stage == Stage::Read) {
+            op->buffer.resize(op->ok ? op->done : 0);
+        } else {
+            if (!op->ok) failedWrites.push_back({op->path, error});
+            writes.erase(op);
+        }
+    }
+
+    void advance(Operation* op, int result) {
+        switch (op->stage) {
+            case Stage::OpenRead:
+            case Stage::OpenWrite:
+                if (result < 0) {
+                    finish(op, -result);
+                    return;
+                }
+                op->fd = result;
+                op->stage = op->stage == Stage::OpenRead ? Stage::Read : Stage::Write;
+                if (op->stage == Stage::Write && op->buffer.empty()) {
+                    submitClose(op->fd);
+                    finish(op, 0);
+                    return;
+                }
+                submitTransfer(op);
+                return;
+            case Stage::Read:
+            case Stage::Write:
+                if (result < 0) {
+                    submitClose(op->fd);
+                    finish(op, -result);
+                    return;
+                }
+                op->done += result;
+                if ((op->stage == Stage::Read && result == 0) || (op->stage == Stage::Write && op->done == op->buffer.size())) {
+                    submitClose(op->fd);
+                    finish(op, 0);
+                    return;
+                }
+                if (op->stage == Stage::Write && result == 0) {
+                    submitClose(op->fd);
+                    finish(op, EIO);
+                    return;
+                }
+                submitTransfer(op);
+                return;
+        }
+    }
+};
+
+#endif
+
+}
+
+unique_ptr<FileBatch> createFileBatch() {
+#ifdef __linux__
+    unique_ptr<FileBatch> batch = UringFileBatch::create();
+    if (batch) return batch;
+#endif
+    return make_unique<ThreadedFileBatch>();
+}
@@ -0,0 +1,42 @@
+#ifndef BATCHIO_HPP
+#define BATCHIO_HPP
+
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+struct BatchRead {
+    string path;
+    string content;
+    bool ok;
+};
+
+// A write that failed to open or to write its file; error is the errno.
+struct BatchWriteError {
+    string path;
+    int error;
+};
+
+// Asynchronous file I/O for batch compilation. Reads are queued ahead with
+// prefetch() and collected in the same order with next(); writes are
+// submitted and never waited on until flush(). Callers must call flush()
+// before destroying the batch: it returns every write that failed since the
+// previous flush() and throws runtime_error when the batch itself fails,
+// while the destructor only waits for outstanding work and logs errors.
+class FileBatch {
+public:
+    virtual ~FileBatch() {}
+    virtual const char* name() const = 0;
+    virtual void prefetch(const string& path) = 0;
+    virtual BatchRead next() = 0;
+    virtual void write(const string& path, string content) = 0;
+    virtual vector<BatchWriteError> flush() = 0;
+};
+
+// Uses io_uring when the kernel supports it, otherwise a background I/O
+// thread doing plain open/read/write/close.
+unique_ptr<FileBatch> createFileBatch();
+
+#endif
@@ -0,0 +1,116 @@
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include "scanner.hpp"
+#include "parser.hpp"
+#include "bytecode.hpp"
+#include "executor.hpp"
+#include "regvm.hpp"
+
+using namespace std;
+
+// Benchmarks the numeric backends of Executor and RegisterVM against each
+// other. Every workload repeats "x = x * 2 + y; y = x / 3 - y;" so values
+// grow by roughly one bit per statement; the number of steps decides whether
+// the results fit in int32, fit in int64, or overflow. The checked backend is the
+// reference: any backend whose variables differ from it is reported as
+// incorrect for that workload (double divides exactly, so it disagrees
+// whenever a DIV has a remainder).
+
+struct Workload {
+    string name;
+    int steps;
+};
+
+struct Result {
+    bool ok;
+    double nsPerRun;
+    vector<long double> values;
+};
+
+string generateProgram(int steps) {
+    stringstream source;
+    source << "begin\nvar x, y;\nx = 1;\n";
+    for (int i = 0; i < steps; i++) {
+        source << "x = x * 2 + y; y = x / 3 - y;\n";
+    }
+    source << "end.\n";
+    return source.str();
+}
+
+void report(const string& name, const Result& result, const Result& reference, string& fastest, double& fastestTime) {
+    bool correct = result.ok && reference.ok && result.values == reference.values;
+    cout << "  " << name << ": ";
+    if (result.ok) {
+        cout << result.nsPerRun << " ns/run";
+    } else {
+        cout << "error";
+    }
+    cout << (correct ? " (correct)" : " (incorrect)") << endl;
+    if (correct && (fastest.empty() || result.nsPerRun < fastestTime)) {
+        fastest = name;
+        fastestTime = result.nsPerRun;
+    }
+}
+
+template <typename Engine, typename Program>
+Result benchmark(const Program& program, int runs) {
+    Result result = {true, 0, {}};
+    try {
+        Engine engine(program);
+        auto begin = chrono::steady_clock::now();
+        for (int i = 0; i < runs; i++) {
+            engine.run();
+        }
+        auto end = chrono::steady_clock::now();
+        result.nsPerRun = chrono::duration<double, nano>(end - begin).count() / runs;
+        for (auto value : engine.getVariables()) {
+            result.values.push_back(static_cast<long double>(value));
+        }
+    } catch (const runtime_error& error) {
+        result.ok = false;
+    }
+    return result;
+}
+
+template <typename Numeric>
+void compareBackend(const Bytecode& bytecode, const RegisterProgram& registers, int runs, const Result& reference, string& fastest, double& fastestTime) {
+    Result stack = benchmark<Executor<Numeric>>(bytecode, runs);
+    Result registerResult = benchmark<RegisterVM<Numeric>>(registers, runs);
+    report(Numeric::name, stack, reference, fastest, fastestTime);
+    report(string(Numeric::name) + " (register VM)", registerResult, reference, fastest, fastestTime);
+}
+
+int main(int argc, char* argv[]) {
+    int runs = argc > 1 ? stoi(argv[1]) : 20000;
+    vector<Workload> workloads = {
+        {"fits-int32", 25}, {"fits-int64", 50}, {"overflows-int64", 80}
+    };
+
+    for (const auto& workload : workloads) {
+        string source = generateProgram(workload.steps);
+        Scanner scanner(source);
+        vector<Token> tokens = scanner.scanTokens();
+        Parser parser(tokens);
+        if (!parser.parse()) {
+            cerr << "Generated program failed to parse: " << workload.name << endl;
+            return 1;
+        }
+        Bytecode bytecode = compileBytecode(parser.getRPNInstructions(), parser.getConstants());
+        RegisterProgram registers = lowerToRegisters(bytecode);
+
+        cout << "Workload " << workload.name << " (" << bytecode.code.size() << " stack / " << registers.code.size()
+             << " register instructions, " << runs << " runs)" << endl;
+        Result reference = benchmark<Executor<CheckedInt64Numeric>>(bytecode, runs);
+        string fastest;
+        double fastestTime = 0;
+        compareBackend<Int32Numeric>(bytecode, registers, runs, reference, fastest, fastestTime);
+        compareBackend<Int64Numeric>(bytecode, registers, runs, reference, fastest, fastestTime);
+        compareBackend<DoubleNumeric>(bytecode, registers, runs, reference, fastest, fastestTime);
+        compareBackend<CheckedInt64Numeric>(bytecode, registers, runs, reference, fastest, fastestTime);
+        cout << "  fastest correct backend: " << (fastest.empty() ? "none" : fastest) << endl << endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,230 @@
+#include "bytecode.hpp"
+#include <unordered_map>
+#include <stdexcept>
+#include <algorithm>
+
+static OpCode parseOpCode(const string& operation) {
+    if (operation == "NUM") return OpCode::Num;
+    if (operation == "RVAL") return OpCode::Rval;
+    if (operation == "STORE") return OpCode::Store;
+    if (operation == "PLUS") return OpCode::Plus;
+    if (operation == "MINUS") return OpCode::Minus;
+    if (operation == "TIMES") return OpCode::Times;
+    if (operation == "DIV") return OpCode::Div;
+    throw runtime_error("Unknown RPN operation " + operation);
+}
+
+string opCodeToString(OpCode op) {
+    switch (op) {
+        case OpCode::Num: return "NUM";
+        case OpCode::Rval: return "RVAL";
+        case OpCode::Store: return "STORE";
+        case OpCode::Plus: return "PLUS";
+        case OpCode::Minus: return "MINUS";
+        case OpCode::Times: return "TIMES";
+        case OpCode::Div: return "DIV";
+    }
+    return "NotImplemented";
+}
+
+namespace {
+
+const uint32_t bytecodeVersion = 1;
+
+class ByteWriter {
+public:
+    vector<uint8_t> bytes;
+
+    void u8(uint8_t value) { bytes.push_back(value); }
+
+    void u32(uint32_t value) {
+        for (int i = 0; i < 4; i++) bytes.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+
+    void u64(uint64_t value) {
+        for (int i = 0; i < 8; i++) bytes.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+
+    void text(const string& value) {
+        u32(static_cast<uint32_t>(value.size()));
+        bytes.insert(bytes.end(), value.begin(), value.end());
+    }
+};
+
+class ByteReader {
+public:
+    ByteReader(const uint8_t* data, size_t size) : data(data), size(size) {}
+
+    uint8_t u8() {
+        need(1);
+        return data[position++];
+    }
+
+    uint32_t u32() {
+        need(4);
+        uint32_t value = 0;
+        for (int i = 0; i < 4; i++) value |= static_cast<uint32_t>(data[position++]) << (8 * i);
+        return value;
+    }
+
+    uint64_t u64() {
+        need(8);
+        uint64_t value = 0;
+        for (int i = 0; i < 8; i++) value |= static_cast<uint64_t>(data[position++]) << (8 * i);
+        return value;
+    }
+
+    string text() {
+        uint32_t length = u32();
+        need(length);
+        string value(reinterpret_cast<const char*>(data + position), length);
+        position += length;
+        return value;
+    }
+
+    // Counts are checked against the bytes left so a corrupt count cannot
+    // trigger a huge allocation.
+    uint32_t count(size_t minimumElementSize) {
+        uint32_t value = u32();
+        if (value > (size - position) / minimumElementSize) throw runtime_error("Malformed bytecode: bad count");
+        return value;
+    }
+
+    bool atEnd() const { return position == size; }
+
+private:
+    const uint8_t* data;
+    size_t size;
+    size_t position = 0;
+
+    void need(size_t bytes) {
+        if (size - position < bytes) throw runtime_error("Malformed bytecode: truncated");
+    }
+};
+
+}
+
+Bytecode compileBytecode(const vector<RPNInstruction>& rpnInstructions, const vector<uint64_t>& constants) {
+    Bytecode bytecode;
+    bytecode.constants = constants;
+    unordered_map<string, int> slots;
+    int depth = 0;
+
+    auto slotFor = [&](const string& name) {
+        auto it = slots.find(name);
+        if (it != slots.end()) return it->second;
+        int slot = static_cast<int>(bytecode.symbols.size());
+        slots.emplace(name, slot);
+        bytecode.symbols.push_back(name);
+        return slot;
+    };
+
+    bytecode.code.reserve(rpnInstructions.size());
+    for (const auto& instr : rpnInstructions) {
+        OpCode op = parseOpCode(instr.operation);
+        int operand = 0;
+        switch (op) {
+            case OpCode::Num:
+                if (instr.constant < 0 || instr.constant >= static_cast<int>(constants.size())) {
+                    throw runtime_error("NUM refers to a missing constant");
+                }
+                operand = instr.constant;
+                depth++;
+                break;
+            case OpCode::Rval:
+                operand = slotFor(instr.operand);
+                depth++;
+                break;
+            case OpCode::Store:
+                operand = slotFor(instr.operand);
+                bytecode.statementLines.push_back(instr.line);
+                depth--;
+                break;
+            default:
+                depth--;
+                break;
+        }
+        if (depth < 0) {
+            throw runtime_error("RPN stack underflow at " + instr.operation);
+        }
+        if (depth > bytecode.maxStackDepth) bytecode.maxStackDepth = depth;
+        bytecode.code.push_back({op, operand});
+    }
+    return bytecode;
+}
+
+
+void validateBytecode(const Bytecode& bytecode) {
+    int depth = 0;
+    int maxDepth = 0;
+    size_t stores = 0;
+    for (const auto& instr : bytecode.code) {
+        size_t limit = 0;
+        switch (instr.op) {
+            case OpCode::Num: limit = bytecode.constants.size(); depth++; break;
+            case OpCode::Rval: limit = bytecode.symbols.size(); depth++; break;
+            case OpCode::Store: limit = bytecode.symbols.size(); depth--; stores++; break;
+            default: depth--; break;
+        }
+        bool hasOperand = instr.op == OpCode::Num || instr.op == OpCode::Rval || instr.op == OpCode::Store;
+        if (hasOperand && (instr.operand < 0 || static_cast<size_t>(instr.operand) >= limit)) {
+            throw runtime_error("Invalid bytecode: operand out of range");
+        }
+        if (depth < 0 || (instr.op == OpCode::Store && depth != 0)) {
+            throw runtime_error("Invalid bytecode: unbalanced stack");
+        }
+        maxDepth = max(maxDepth, depth);
+    }
+    if (depth != 0 || maxDepth != bytecode.maxStackDepth) throw runtime_error("Invalid bytecode: unbalanced stack");
+    if (!bytecode.statementLines.empty() && bytecode.statementLines.size() != stores) {
+        throw runtime_error("Invalid bytecode: statement lines do not match statements");
+    }
+}
+
+vector<uint8_t> serializeBytecode(const Bytecode& bytecode) {
+    ByteWriter writer;
+    writer.bytes = {'R', 'P', 'N', 'B'};
+    writer.u32(bytecodeVersion);
+    writer.u32(static_cast<uint32_t>(bytecode.maxStackDepth));
+
+    writer.u32(static_cast<uint32_t>(bytecode.code.size()));
+    for (const auto& instr : bytecode.code) {
+        writer.u8(static_cast<uint8_t>(instr.op));
+        writer.u32(static_cast<uint32_t>(instr.operand));
+    }
+    writer.u32(static_cast<uint32_t>(bytecode.symbols.size()));
+    for (const auto& symbol : bytecode.symbols) writer.text(symbol);
+    writer.u32(static_cast<uint32_t>(bytecode.constants.size()));
+    for (uint64_t constant : bytecode.constants) writer.u64(constant);
+    writer.u32(static_cast<uint32_t>(bytecode.statementLines.size()));
+    for (int line : bytecode.statementLines) writer.u32(static_cast<uint32_t>(line));
+    return writer.bytes;
+}
+
+Bytecode deserializeBytecode(const uint8_t* data, size_t size) {
+    if (size < 4 || data[0] != 'R' || data[1] != 'P' || data[2] != 'N' || data[3] != 'B') {
+        throw runtime_error("Malformed bytecode: bad magic");
+    }
+    ByteReader reader(data + 4, size - 4);
+    if (reader.u32() != bytecodeVersion) throw runtime_error("Unsupported bytecode version");
+
+    Bytecode bytecode;
+    bytecode.maxStackDepth = static_cast<int>(reader.u32());
+    bytecode.code.resize(reader.count(5));
+    for (auto& instr : bytecode.code) {
+        uint8_t op = reader.u8();
+        if (op > static_cast<uint8_t>(OpCode::Div)) throw runtime_error("Malformed bytecode: bad opcode");
+        instr.op = static_cast<OpCode>(op);
+        instr.operand = static_cast<int>(reader.u32());
+    }
+    bytecode.symbols.resize(reader.count(4));
+    for (auto& symbol : bytecode.symbols) symbol = reader.text();
+    bytecode.constants.resize(reader.count(8));
+    for (auto& constant : bytecode.constants) constant = reader.u64();
+    bytecode.statementLines.resize(reader.count(4));
+    for (auto& line : bytecode.statementLines) line = static_cast<int>(reader.u32());
+    if (!reader.atEnd()) throw runtime_error("Malformed bytecode: trailing bytes");
+
+    validateBytecode(bytecode);
+    return bytecode;
+}
@@ -0,0 +1,61 @@
+#ifndef BYTECODE_HPP
+#define BYTECODE_HPP
+
+#include "parser.hpp"
+#include <vector>
+#include <string>
+#include <cstdint>
+
+enum class OpCode {
+    Num, Rval, Store, Plus, Minus, Times, Div
+};
+
+struct Instruction {
+    OpCode op;
+    int operand;
+};
+
+// Executes one stack instruction: pushes and pops at sp and returns the new
+// top. slot(operand) yields a reference to the variable an RVAL or STORE
+// names. Every stack interpreter goes through this, so an opcode means the
+// same thing in all of them.
+template <typename Numeric, typename Slot>
+inline typename Numeric::Value* executeInstruction(const Instruction& instr, typename Numeric::Value* sp,
+                                                   const typename Numeric::Value* constants, Slot&& slot) {
+    switch (instr.op) {
+        case OpCode::Num: *sp++ = constants[instr.operand]; break;
+        case OpCode::Rval: *sp++ = slot(instr.operand); break;
+        case OpCode::Store: slot(instr.operand) = *--sp; break;
+        case OpCode::Plus: --sp; sp[-1] = Numeric::add(sp[-1], sp[0]); break;
+        case OpCode::Minus: --sp; sp[-1] = Numeric::sub(sp[-1], sp[0]); break;
+        case OpCode::Times: --sp; sp[-1] = Numeric::mul(sp[-1], sp[0]); break;
+        case OpCode::Div: --sp; sp[-1] = Numeric::div(sp[-1], sp[0]); break;
+    }
+    return sp;
+}
+
+// RPN lowered to compact opcodes: variable operands become slot indices and
+// NUM operands index the parser's constant pool. statementLines holds the
+// source line of each STORE, in order.
+struct Bytecode {
+    vector<Instruction> code;
+    vector<string> symbols;
+    vector<uint64_t> constants;
+    vector<int> statementLines;
+    int maxStackDepth = 0;
+};
+
+Bytecode compileBytecode(const vector<RPNInstruction>& rpnInstructions, const vector<uint64_t>& constants);
+string opCodeToString(OpCode op);
+
+// Portable binary form: a "RPNB" header and version, then the code,
+// symbols, constants and statement lines as little-endian counted arrays.
+// deserializeBytecode throws runtime_error on malformed input.
+vector<uint8_t> serializeBytecode(const Bytecode& bytecode);
+Bytecode deserializeBytecode(const uint8_t* data, size_t size);
+
+// Checks operand ranges and stack balance so bytecode from outside the
+// compiler is safe to execute; throws runtime_error if it is not.
+void validateBytecode(const Bytecode& bytecode);
+
+#endif
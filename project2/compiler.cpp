@@ -0,0 +1,55 @@
+#include "compiler.hpp"
+#include "scanner.hpp"
+#include "parser.hpp"
+#include <cstring>
+#include <sstream>
+
+bool compileSource(const char* source, size_t length, ParseMode mode, string& diagnostics, Bytecode& bytecode) {
+    stringstream messages;
+    Scanner scanner(string_view(source, length), messages);
+    vector<Token> tokens = scanner.scanTokens();
+
+    Parser parser(tokens, mode, messages);
+    bool success = parser.parse();
+    if (success && mode == ParseMode::Full) {
+        bytecode = compileBytecode(parser.getRPNInstructions(), parser.getConstants());
+    }
+    diagnostics = messages.str();
+    return success;
+}
+
+bool compileSource(const char* source, size_t length, ParseMode mode, string& diagnostics, vector<uint8_t>& bytecode) {
+    Bytecode compiled;
+    bool success = compileSource(source, length, mode, diagnostics, compiled);
+    bytecode.clear();
+    if (success && mode == ParseMode::Full) {
+        bytecode = serializeBytecode(compiled);
+    }
+    return success;
+}
+
+extern "C" compiler_status compiler_compile(const char* source, size_t length, compiler_mode mode,
+                                            char* diagnostics, size_t diagnostics_capacity, size_t* diagnostics_length,
+                                            unsigned char* bytecode, size_t bytecode_capacity, size_t* bytecode_length) {
+    try {
+        string messages;
+        vector<uint8_t> compiled;
+        ParseMode parseMode = mode == COMPILER_MODE_SYNTAX_ONLY ? ParseMode::SyntaxOnly : ParseMode::Full;
+        bool success = compileSource(source, length, parseMode, messages, compiled);
+
+        if (diagnostics_length != nullptr) *diagnostics_length = messages.size();
+        if (diagnostics != nullptr && diagnostics_capacity > 0) {
+            size_t copied = min(messages.size(), diagnostics_capacity - 1);
+            memcpy(diagnostics, messages.data(), copied);
+            diagnostics[copied] = '\0';
+        }
+
+        if (bytecode_length != nullptr) *bytecode_length = compiled.size();
+        if (!success) return COMPILER_ERROR;
+        if (compiled.size() > bytecode_capacity) return COMPILER_BUFFER_TOO_SMALL;
+        if (!compiled.empty()) memcpy(bytecode, compiled.data(), compiled.size());
+        return COMPILER_OK;
+    } catch (...) {
+        return COMPILER_INTERNAL_ERROR;
+    }
+}
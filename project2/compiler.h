@@ -0,0 +1,42 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+
+/* C interface of libcompiler: compiles a program held in memory without
+ * touching the filesystem. Output goes into caller-provided buffers. */
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    COMPILER_MODE_FULL = 0,
+    COMPILER_MODE_SYNTAX_ONLY = 1
+} compiler_mode;
+
+typedef enum {
+    COMPILER_OK = 0,
+    COMPILER_ERROR = 1,
+    COMPILER_BUFFER_TOO_SMALL = 2,
+    COMPILER_INTERNAL_ERROR = 3
+} compiler_status;
+
+/* Compiles length bytes at source. Diagnostics are written to diagnostics
+ * as a NUL-terminated string, truncated to diagnostics_capacity. In full
+ * mode the serialized bytecode (see serializeBytecode) is written to
+ * bytecode; syntax-only mode produces none. The *_length outputs always
+ * receive the full size, so on COMPILER_BUFFER_TOO_SMALL the call can be
+ * retried with a large enough bytecode buffer. Any pointer may be NULL
+ * when its capacity is 0. Syntax-only mode still parses expressions with
+ * the full grammar (see ParseMode::SyntaxOnly); it only skips declaration
+ * checks and code generation. */
+compiler_status compiler_compile(const char* source, size_t length, compiler_mode mode,
+                                 char* diagnostics, size_t diagnostics_capacity, size_t* diagnostics_length,
+                                 unsigned char* bytecode, size_t bytecode_capacity, size_t* bytecode_length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef COMPILER_HPP
+#define COMPILER_HPP
+
+#include "parser.hpp"
+#include "bytecode.hpp"
+#include "compiler.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// C++ interface of libcompiler. Compiles from a caller-owned buffer;
+// diagnostics receives the scanner and parser messages and, in full mode,
+// bytecode receives the compiled program. Returns whether compilation
+// succeeded. Nothing is read from or written to the filesystem.
+bool compileSource(const char* source, size_t length, ParseMode mode, string& diagnostics, Bytecode& bytecode);
+
+// Same, with the bytecode serialized into a caller-provided vector.
+bool compileSource(const char* source, size_t length, ParseMode mode, string& diagnostics, vector<uint8_t>& bytecode);
+
+#endif
@@ -0,0 +1,363 @@
+#include "compression.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace {
+
+const size_t inputChunkSize = 64 * 1024;
+
+// Where the (possibly compressed) bytes of an input come from.
+class Input {
+public:
+    virtual ~Input() {}
+    virtual size_t read(char* data, size_t size) = 0;
+};
+
+class File : public Input {
+public:
+    File(const string& path, const char* mode) : handle(fopen(path.c_str(), mode)) {
+        if (handle == nullptr) throw runtime_error("Could not open file: " + path);
+    }
+    ~File() override { fclose(handle); }
+
+    size_t read(char* data, size_t size) override {
+        size_t n = fread(data, 1, size, handle);
+        if (n < size && ferror(handle)) throw runtime_error("Error reading compressed input");
+        return n;
+    }
+
+    void write(const char* data, size_t size) {
+        if (fwrite(data, 1, size, handle) != size) throw runtime_error("Error writing compressed output");
+    }
+
+private:
+    FILE* handle;
+};
+
+// Bytes that were already read into memory, such as a batch read.
+class MemoryInput : public Input {
+public:
+    MemoryInput(string content) : content(move(content)) {}
+
+    size_t read(char* data, size_t size) override {
+        size_t n = min(size, content.size() - offset);
+        memcpy(data, content.data() + offset, n);
+        offset += n;
+        return n;
+    }
+
+private:
+    string content;
+    size_t offset = 0;
+};
+
+class PlainReader : public BlockReader {
+public:
+    PlainReader(unique_ptr<Input> input, size_t blockSize) : input(move(input)), blockSize(blockSize) {}
+
+    bool next(string& block) override {
+        block.resize(blockSize);
+        block.resize(input->read(&block[0], blockSize));
+        return !block.empty();
+    }
+
+private:
+    unique_ptr<Input> input;
+    size_t blockSize;
+};
+
+#ifdef HAVE_ZLIB
+class GzipReader : public BlockReader {
+public:
+    GzipReader(unique_ptr<Input> file, size_t blockSize) : file(move(file)), blockSize(blockSize), input(inputChunkSize) {
+        // 16 + MAX_WBITS selects the gzip wrapper.
+        if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK) throw runtime_error("Could not initialize zlib");
+    }
+    ~GzipReader() override { inflateEnd(&stream); }
+
+    bool next(string& block) override {
+        block.resize(blockSize);
+        stream.next_out = reinterpret_cast<Bytef*>(&block[0]);
+        stream.avail_out = static_cast<uInt>(blockSize);
+
+        while (stream.avail_out > 0) {
+            if (stream.avail_in == 0) {
+                if (inputDone) break;
+                size_t n = file->read(input.data(), input.size());
+                if (n == 0) {
+                    inputDone = true;
+                    if (!memberDone) throw runtime_error("Truncated gzip input");
+                    break;
+                }
+                stream.next_in = reinterpret_cast<Bytef*>(input.data());
+                stream.avail_in = static_cast<uInt>(n);
+            }
+            if (memberDone) {
+                // Concatenated gzip members are decoded as one stream.
+                inflateReset(&stream);
+                memberDone = false;
+            }
+            int status = inflate(&stream, Z_NO_FLUSH);
+            if (status == Z_STREAM_END) {
+                memberDone = true;
+            } else if (status != Z_OK && status != Z_BUF_ERROR) {
+                throw runtime_error("Corrupt gzip input");
+            }
+        }
+        block.resize(blockSize - stream.avail_out);
+        return !block.empty();
+    }
+
+private:
+    unique_ptr<Input> file;
+    size_t blockSize;
+    vector<char> input;
+    z_stream stream = {};
+    bool inputDone = false;
+    bool memberDone = false;
+};
+#endif
+
+#ifdef HAVE_ZSTD
+class ZstdReader : public BlockReader {
+public:
+    ZstdReader(unique_ptr<Input> file, size_t blockSize)
+        : file(move(file)), blockSize(blockSize), input(ZSTD_DStreamInSize()), context(ZSTD_createDCtx()) {
+        if (context == nullptr) throw runtime_error("Could not initialize zstd");
+    }
+    ~ZstdReader() override { ZSTD_freeDCtx(context); }
+
+    bool next(string& block) override {
+        block.resize(blockSize);
+        ZSTD_outBuffer out = {&block[0], blockSize, 0};
+
+        while (out.pos < out.size) {
+            if (in.pos == in.size) {
+                if (inputDone) break;
+                size_t n = file->read(input.data(), input.size());
+                if (n == 0) {
+                    inputDone = true;
+                    if (!frameDone) throw runtime_error("Truncated zstd input");
+                    break;
+                }
+                in = {input.data(), n, 0};
+            }
+            size_t result = ZSTD_decompressStream(context, &out, &in);
+            if (ZSTD_isError(result)) throw runtime_error(string("Corrupt zstd input: ") + ZSTD_getErrorName(result));
+            frameDone = result == 0;
+        }
+        block.resize(out.pos);
+        return !block.empty();
+    }
+
+private:
+    unique_ptr<Input> file;
+    size_t blockSize;
+    vector<char> input;
+    ZSTD_inBuffer in = {nullptr, 0, 0};
+    ZSTD_DCtx* context;
+    bool inputDone = false;
+    bool frameDone = true;
+};
+#endif
+
+class PrefetchingReader : public BlockReader {
+public:
+    PrefetchingReader(unique_ptr<BlockReader> source, size_t queuedBlocks)
+        : source(move(source)), queuedBlocks(queuedBlocks), producer(&PrefetchingReader::produce, this) {}
+
+    ~PrefetchingReader() override {
+        {
+            lock_guard<mutex> lock(guard);
+            stopping = true;
+        }
+        changed.notify_all();
+        producer.join();
+    }
+
+    bool next(string& block) override {
+        unique_lock<mutex> lock(guard);
+        changed.wait(lock, [&] { return !ready.empty() || finished; });
+        if (ready.empty()) {
+            if (!error.empty()) throw runtime_error(error);
+            return false;
+        }
+        block = move(ready.front());
+        ready.pop_front();
+        changed.notify_all();
+        return true;
+    }
+
+private:
+    unique_ptr<BlockReader> source;
+    size_t queuedBlocks;
+    mutex guard;
+    condition_variable changed;
+    deque<string> ready;
+    bool finished = false;
+    bool stopping = false;
+    string error;
+    thread producer;
+
+    void produce() {
+        try {
+            string block;
+            while (source->next(block)) {
+                unique_lock<mutex> lock(guard);
+                changed.wait(lock, [&] { return ready.size() < queuedBlocks || stopping; });
+                if (stopping) break;
+                ready.push_back(move(block));
+                changed.notify_all();
+            }
+        } catch (const runtime_error& e) {
+            lock_guard<mutex> lock(guard);
+            error = e.what();
+        }
+        lock_guard<mutex> lock(guard);
+        finished = true;
+        changed.notify_all();
+    }
+};
+
+}
+
+Compression detectCompression(string_view header) {
+    auto byte = [&](size_t i) { return static_cast<unsigned char>(header[i]); };
+    if (header.size() >= 2 && byte(0) == 0x1f && byte(1) == 0x8b) return Compression::Gzip;
+    if (header.size() >= 4 && byte(0) == 0x28 && byte(1) == 0xb5 && byte(2) == 0x2f && byte(3) == 0xfd) {
+        return Compression::Zstd;
+    }
+    return Compression::None;
+}
+
+Compression detectFileCompression(const string& path) {
+    char magic[4];
+    FILE* handle = fopen(path.c_str(), "rb");
+    if (handle == nullptr) return Compression::None;
+    size_t n = fread(magic, 1, sizeof(magic), handle);
+    fclose(handle);
+    return detectCompression(string_view(magic, n));
+}
+
+const char* compressionName(Compression compression) {
+    switch (compression) {
+        case Compression::None: return "none";
+        case Compression::Gzip: return "gzip";
+        case Compression::Zstd: return "zstd";
+    }
+    return "unknown";
+}
+
+const char* compressionSuffix(Compression compression) {
+    switch (compression) {
+        case Compression::Gzip: return ".gz";
+        case Compression::Zstd: return ".zst";
+        default: return "";
+    }
+}
+
+bool compressionSupported(Compression compression) {
+    switch (compression) {
+        case Compression::None: return true;
+#ifdef HAVE_ZLIB
+        case Compression::Gzip: return true;
+#endif
+#ifdef HAVE_ZSTD
+        case Compression::Zstd: return true;
+#endif
+        default: return false;
+    }
+}
+
+namespace {
+
+unique_ptr<BlockReader> openReader(unique_ptr<Input> input, Compression compression, size_t blockSize, size_t queuedBlocks) {
+    unique_ptr<BlockReader> reader;
+    if (compression == Compression::None) {
+        reader.reset(new PlainReader(move(input), blockSize));
+#ifdef HAVE_ZLIB
+    } else if (compression == Compression::Gzip) {
+        reader.reset(new GzipReader(move(input), blockSize));
+#endif
+#ifdef HAVE_ZSTD
+    } else if (compression == Compression::Zstd) {
+        reader.reset(new ZstdReader(move(input), blockSize));
+#endif
+    } else {
+        throw runtime_error(string(compressionName(compression)) + " support is not compiled in");
+    }
+    return make_unique<PrefetchingReader>(move(reader), queuedBlocks);
+}
+
+}
+
+unique_ptr<BlockReader> openBlockReader(const string& path, Compression compression, size_t blockSize, size_t queuedBlocks) {
+    return openReader(make_unique<File>(path, "rb"), compression, blockSize, queuedBlocks);
+}
+
+unique_ptr<BlockReader> openMemoryBlockReader(string content, Compression compression, size_t blockSize, size_t queuedBlocks) {
+    return openReader(make_unique<MemoryInput>(move(content)), compression, blockSize, queuedBlocks);
+}
+
+string stripCompressionSuffix(const string& path, Compression compression) {
+    string suffix = compressionSuffix(compression);
+    if (!suffix.empty() && path.size() > suffix.size() && path.compare(path.size() - suffix.size(), suffix.size(), suffix) == 0) {
+        return path.substr(0, path.size() - suffix.size());
+    }
+    return path;
+}
+
+string compressData(const string& content, Compression compression) {
+    switch (compression) {
+#ifdef HAVE_ZLIB
+        case Compression::Gzip: {
+            z_stream stream = {};
+            // 16 + MAX_WBITS selects the gzip wrapper.
+            if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+                throw runtime_error("Could not initialize zlib");
+            }
+            string compressed(deflateBound(&stream, content.size()), '\0');
+            stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(content.data()));
+            stream.avail_in = static_cast<uInt>(content.size());
+            stream.next_out = reinterpret_cast<Bytef*>(&compressed[0]);
+            stream.avail_out = static_cast<uInt>(compressed.size());
+            int status = deflate(&stream, Z_FINISH);
+            compressed.resize(stream.total_out);
+            deflateEnd(&stream);
+            if (status != Z_STREAM_END) throw runtime_error("gzip compression failed");
+            return compressed;
+        }
+#endif
+#ifdef HAVE_ZSTD
+        case Compression::Zstd: {
+            string compressed(ZSTD_compressBound(content.size()), '\0');
+            size_t size = ZSTD_compress(&compressed[0], compressed.size(), content.data(), content.size(), 3);
+            if (ZSTD_isError(size)) throw runtime_error(string("zstd compression failed: ") + ZSTD_getErrorName(size));
+            compressed.resize(size);
+            return compressed;
+        }
+#endif
+        default:
+            throw runtime_error(string(compressionName(compression)) + " output is not supported");
+    }
+}
+
+void writeCompressedFile(const string& path, const string& content, Compression compression) {
+    string compressed = compressData(content, compression);
+    File file(path, "wb");
+    file.write(compressed.data(), compressed.size());
+}
@@ -0,0 +1,50 @@
+#ifndef COMPRESSION_HPP
+#define COMPRESSION_HPP
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+using namespace std;
+
+enum class Compression {
+    None, Gzip, Zstd
+};
+
+// Recognizes gzip and zstd input by its magic bytes, given either the
+// start of the data or the path of the file.
+Compression detectCompression(string_view header);
+Compression detectFileCompression(const string& path);
+const char* compressionName(Compression compression);
+bool compressionSupported(Compression compression);
+
+// Hands out a file's contents, decompressed, one block at a time; next()
+// returns false once everything has been read and throws runtime_error on
+// I/O errors or corrupt data.
+class BlockReader {
+public:
+    virtual ~BlockReader() {}
+    virtual bool next(string& block) = 0;
+};
+
+// Decompresses on a background thread, at most queuedBlocks blocks ahead of
+// the caller, so memory use is bounded by the block size rather than the
+// size of the file.
+unique_ptr<BlockReader> openBlockReader(const string& path, Compression compression,
+                                        size_t blockSize = 256 * 1024, size_t queuedBlocks = 2);
+
+// Same, for input that has already been read into memory.
+unique_ptr<BlockReader> openMemoryBlockReader(string content, Compression compression,
+                                              size_t blockSize = 256 * 1024, size_t queuedBlocks = 2);
+
+// Path without a trailing .gz/.zst for the given compression.
+string stripCompressionSuffix(const string& path, Compression compression);
+
+// Compresses content in memory with the given method (not None).
+string compressData(const string& content, Compression compression);
+
+// Writes content to path compressed with the given method (not None).
+void writeCompressedFile(const string& path, const string& content, Compression compression);
+const char* compressionSuffix(Compression compression);
+
+#endif
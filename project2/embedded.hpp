@@ -0,0 +1,279 @@
+#ifndef EMBEDDED_HPP
+#define EMBEDDED_HPP
+
+#include "grammar.hpp"
+#include "bytecode.hpp"
+#include <array>
+#include <stdexcept>
+#include <string_view>
+
+// Compile-time compiler for programs embedded as string literals:
+//
+//     constexpr auto program = EMBEDDED_PROGRAM("begin var a; a = 1+2; end.");
+//
+// compiles the literal while the C++ code is being built, and any syntax or
+// semantic error becomes a compile error naming one of the *Error functions
+// below. The parse is grammar::Syntax, the same one Parser runs, and the
+// lexer uses the same character tables as Scanner, so a program is accepted
+// here exactly when it compiles at run time, with one exception: the
+// compiler's tables are fixed, so a program with more than maxSymbols
+// variables or maxConstants distinct constants is rejected here (with
+// tooManySymbolsError or tooManyConstantsError) although it would compile
+// at run time. As there, unexpected characters
+// are skipped (the Scanner also prints a diagnostic, which cannot be done
+// during constant evaluation), and the result matches compileBytecode:
+// slots are numbered in order of first use. Besides maxNestingDepth, the
+// compiler's own constexpr recursion limit may reject very deep nesting.
+
+namespace embedded {
+
+constexpr size_t maxSymbols = 256;
+constexpr size_t maxConstants = 256;
+
+// Deliberately not constexpr: reaching one of these during constant
+// evaluation is what turns a program error into a C++ compile error.
+inline void syntaxError(const char* message) { throw runtime_error(message); }
+inline void undefinedVariableError() { throw runtime_error("Undefined variable"); }
+inline void illegalRedefinitionError() { throw runtime_error("Illegal redefinition"); }
+inline void invalidIdentifierError(const char* message) { throw runtime_error(message); }
+inline void numberOutOfRangeError() { throw runtime_error("Numeric literal out of range"); }
+inline void tooManySymbolsError() { throw runtime_error("Too many variables in embedded program"); }
+inline void tooManyConstantsError() { throw runtime_error("Too many distinct constants in embedded program"); }
+
+struct EmbeddedToken {
+    TokenType type;
+    string_view text;
+};
+
+struct Sizes {
+    size_t code = 0;
+    size_t symbols = 0;
+    size_t constants = 0;
+};
+
+template <size_t CodeSize, size_t SymbolCount, size_t ConstantCount>
+struct Program {
+    array<Instruction, CodeSize> code{};
+    array<string_view, SymbolCount> symbols{};
+    array<uint64_t, ConstantCount> constants{};
+    int maxStackDepth = 0;
+
+    Bytecode toBytecode() const {
+        Bytecode bytecode;
+        bytecode.code.assign(code.begin(), code.end());
+        for (auto symbol : symbols) bytecode.symbols.emplace_back(symbol);
+        bytecode.constants.assign(constants.begin(), constants.end());
+        bytecode.maxStackDepth = maxStackDepth;
+        return bytecode;
+    }
+};
+
+// Only counts what it is given; used to size the arrays of Program.
+struct CountingSink {
+    Sizes sizes;
+
+    constexpr void emit(OpCode, int) { sizes.code++; }
+    constexpr void symbol(string_view) { sizes.symbols++; }
+    constexpr void constant(uint64_t) { sizes.constants++; }
+    constexpr void stackDepth(int) {}
+};
+
+template <typename P>
+struct ProgramSink {
+    P program;
+
+    constexpr void emit(OpCode op, int operand) { program.code[code++] = {op, operand}; }
+    constexpr void symbol(string_view name) { program.symbols[symbols++] = name; }
+    constexpr void constant(uint64_t value) { program.constants[constants++] = value; }
+    constexpr void stackDepth(int depth) { program.maxStackDepth = depth; }
+
+    size_t code = 0;
+    size_t symbols = 0;
+    size_t constants = 0;
+};
+
+template <typename Sink>
+class Compiler {
+public:
+    constexpr Compiler(string_view source, Sink& sink) : source(source), sink(sink) {
+        advance();
+    }
+
+    constexpr void compile() {
+        grammar::Syntax<Compiler> syntax(*this);
+        syntax.program();
+        sink.stackDepth(maxDepth);
+    }
+
+private:
+    string_view source;
+    Sink& sink;
+    size_t current = 0;
+    EmbeddedToken token{TokenType::Eof, {}};
+    EmbeddedToken previous{TokenType::Eof, {}};
+    array<string_view, maxSymbols> declared{};
+    size_t declaredCount = 0;
+    array<string_view, maxSymbols> slots{};
+    size_t slotCount = 0;
+    array<uint64_t, maxConstants> constants{};
+    size_t constantCount = 0;
+    int depth = 0;
+    int maxDepth = 0;
+
+    constexpr void skipWhitespaceAndComments() {
+        while (current < source.size()) {
+            if (grammar::isWhitespace(source[current])) {
+                current++;
+            } else if (source[current] == grammar::commentStart) {
+                while (current < source.size() && source[current] != '\n') current++;
+            } else {
+                return;
+            }
+        }
+    }
+
+    constexpr void advance() {
+        previous = token;
+        while (true) {
+            skipWhitespaceAndComments();
+            if (current >= source.size()) {
+                token = {TokenType::Eof, {}};
+                return;
+            }
+
+            size_t start = current;
+            char c = source[current++];
+            TokenType type = grammar::punctuation(c);
+            if (type != TokenType::Unknown) {
+                token = {type, source.substr(start, 1)};
+            } else if (grammar::isDigit(c)) {
+                while (current < source.size() && grammar::isDigit(source[current])) current++;
+                token = {TokenType::Number, source.substr(start, current - start)};
+            } else if (grammar::isAlpha(c)) {
+                while (current < source.size() && grammar::isAlphaNumeric(source[current])) current++;
+                string_view text = source.substr(start, current - start);
+                token = {grammar::keyword(text), text};
+            } else {
+                // Unexpected character: skipped, as by Scanner.
+                continue;
+            }
+            return;
+        }
+    }
+
+    // Host interface of grammar::Syntax.
+    friend class grammar::Syntax<Compiler>;
+
+    constexpr bool check(TokenType type) const { return !isAtEnd() && token.type == type; }
+    constexpr bool isAtEnd() const { return token.type == TokenType::Eof; }
+    constexpr TokenType previousType() const { return previous.type; }
+
+    constexpr bool match(TokenType type) {
+        if (!check(type)) return false;
+        advance();
+        return true;
+    }
+
+    void syntaxError(const char* message) { embedded::syntaxError(message); }
+    void errorAtPrevious(const char* message) { embedded::syntaxError(message); }
+
+    constexpr int find(const array<string_view, maxSymbols>& names, size_t count, string_view name) const {
+        for (size_t i = 0; i < count; i++) {
+            if (names[i] == name) return static_cast<int>(i);
+        }
+        return -1;
+    }
+
+    constexpr void declare() {
+        if (find(declared, declaredCount, previous.text) >= 0) illegalRedefinitionError();
+        if (declaredCount == maxSymbols) tooManySymbolsError();
+        declared[declaredCount++] = previous.text;
+    }
+
+    constexpr void validateIdentifier(string_view name) const {
+        const char* message = grammar::identifierError(name);
+        if (message != nullptr) invalidIdentifierError(message);
+        if (find(declared, declaredCount, name) < 0) undefinedVariableError();
+    }
+
+    // Slots are numbered in order of first use, as in compileBytecode.
+    constexpr int slot(string_view name) {
+        int index = find(slots, slotCount, name);
+        if (index >= 0) return index;
+        slots[slotCount] = name;
+        sink.symbol(name);
+        return static_cast<int>(slotCount++);
+    }
+
+    // Identical literals share one constant, as in Parser::addConstant.
+    constexpr int constant(uint64_t value) {
+        for (size_t i = 0; i < constantCount; i++) {
+            if (constants[i] == value) return static_cast<int>(i);
+        }
+        if (constantCount == maxConstants) tooManyConstantsError();
+        constants[constantCount] = value;
+        sink.constant(value);
+        return static_cast<int>(constantCount++);
+    }
+
+    constexpr void emit(OpCode op, int operand, int stackEffect) {
+        sink.emit(op, operand);
+        depth += stackEffect;
+        if (depth > maxDepth) maxDepth = depth;
+    }
+
+    constexpr string_view target() {
+        validateIdentifier(previous.text);
+        return previous.text;
+    }
+
+    constexpr void store(string_view target) {
+        emit(OpCode::Store, slot(target), -1);
+    }
+
+    constexpr void number() {
+        uint64_t value = 0;
+        if (!grammar::decodeNumber(previous.text, value)) numberOutOfRangeError();
+        emit(OpCode::Num, constant(value), 1);
+    }
+
+    constexpr void variable() {
+        validateIdentifier(previous.text);
+        emit(OpCode::Rval, slot(previous.text), 1);
+    }
+
+    constexpr void binary(TokenType op) {
+        switch (op) {
+            case TokenType::Plus: emit(OpCode::Plus, 0, -1); break;
+            case TokenType::Minus: emit(OpCode::Minus, 0, -1); break;
+            case TokenType::Multiply: emit(OpCode::Times, 0, -1); break;
+            default: emit(OpCode::Div, 0, -1); break;
+        }
+    }
+};
+
+constexpr Sizes measure(string_view source) {
+    CountingSink sink;
+    Compiler<CountingSink> compiler(source, sink);
+    compiler.compile();
+    return sink.sizes;
+}
+
+template <size_t CodeSize, size_t SymbolCount, size_t ConstantCount>
+constexpr Program<CodeSize, SymbolCount, ConstantCount> compile(string_view source) {
+    ProgramSink<Program<CodeSize, SymbolCount, ConstantCount>> sink;
+    Compiler<decltype(sink)> compiler(source, sink);
+    compiler.compile();
+    return sink.program;
+}
+
+}
+
+// The program is measured once, then compiled into arrays of that size.
+#define EMBEDDED_PROGRAM(source)                                                            \
+    ([] {                                                                                   \
+        constexpr embedded::Sizes sizes = embedded::measure(source);                        \
+        return embedded::compile<sizes.code, sizes.symbols, sizes.constants>(source);       \
+    }())
+
+#endif
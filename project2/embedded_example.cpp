@@ -0,0 +1,73 @@
+#include <iostream>
+#include "embedded.hpp"
+#include "executor.hpp"
+#include "numeric.hpp"
+#include "compiler.hpp"
+
+using namespace std;
+
+// Example and check for EMBEDDED_PROGRAM, built with "make embedded-example".
+// The static_asserts pin down what the compile-time compiler produces, and
+// main() compares it with what the runtime compiler makes of the same
+// source before running it. "make embedded-errors" compiles this file once
+// per BROKEN_PROGRAM value below and fails unless every one of them is
+// rejected by the C++ compiler.
+
+#define EXAMPLE_SOURCE                 \
+    "begin\n"                          \
+    "var total, step, unused;\n"       \
+    "~ slots follow first use\n"       \
+    "step = 3;\n"                      \
+    "total = step * (step + 4) - 2;\n" \
+    "total = total / step;\n"          \
+    "end.\n"
+
+constexpr auto example = EMBEDDED_PROGRAM(EXAMPLE_SOURCE);
+
+static_assert(example.symbols.size() == 2 && example.symbols[0] == "step" && example.symbols[1] == "total",
+              "slots are numbered in order of first use; unused variables get none");
+static_assert(example.constants.size() == 3 && example.constants[0] == 3 && example.constants[1] == 4 &&
+              example.constants[2] == 2, "identical literals share one constant");
+static_assert(example.code.size() == 14 && example.code[0].op == OpCode::Num && example.code[1].op == OpCode::Store &&
+              example.code[13].op == OpCode::Store && example.code[13].operand == 1, "RPN order, as compileBytecode");
+static_assert(example.maxStackDepth == 3, "step, step and 4 are on the stack before PLUS");
+
+// Unexpected characters are skipped, as the Scanner does after reporting them.
+static_assert(EMBEDDED_PROGRAM("begin var a; a = 1 @ + 2; end.").code.size() == 4);
+
+#if BROKEN_PROGRAM == 1
+constexpr auto broken = EMBEDDED_PROGRAM("begin var a; a = b; end.");  // undefined variable
+#elif BROKEN_PROGRAM == 2
+constexpr auto broken = EMBEDDED_PROGRAM("begin var a; a = 1 + ; end.");  // expected expression
+#elif BROKEN_PROGRAM == 3
+constexpr auto broken = EMBEDDED_PROGRAM("begin var a, a; a = 1; end.");  // illegal redefinition
+#elif BROKEN_PROGRAM == 4
+constexpr auto broken = EMBEDDED_PROGRAM("begin var a_; a_ = 1; end.");  // invalid identifier
+#elif BROKEN_PROGRAM == 5
+constexpr auto broken = EMBEDDED_PROGRAM("begin var a; a = 99999999999999999999; end.");  // out of range
+#endif
+
+int main() {
+    Bytecode embedded = example.toBytecode();
+    const char* source = EXAMPLE_SOURCE;
+    string diagnostics;
+    Bytecode runtime;
+    if (!compileSource(source, char_traits<char>::length(source), ParseMode::Full, diagnostics, runtime)) {
+        cout << "Runtime compiler rejected the example: " << diagnostics << endl;
+        return 1;
+    }
+    bool same = embedded.symbols == runtime.symbols && embedded.constants == runtime.constants &&
+                embedded.maxStackDepth == runtime.maxStackDepth && embedded.code.size() == runtime.code.size();
+    for (size_t i = 0; same && i < embedded.code.size(); i++) {
+        same = embedded.code[i].op == runtime.code[i].op && embedded.code[i].operand == runtime.code[i].operand;
+    }
+    cout << "Embedded and runtime bytecode " << (same ? "match" : "differ") << endl;
+
+    Executor<Int64Numeric> executor(embedded);
+    executor.run();
+    vector<int64_t> values = executor.getVariables();
+    for (size_t i = 0; i < values.size(); i++) {
+        cout << "  " << embedded.symbols[i] << " = " << values[i] << endl;
+    }
+    return same ? 0 : 1;
+}
@@ -0,0 +1,118 @@
+#ifndef EXECUTOR_HPP
+#define EXECUTOR_HPP
+
+#include "bytecode.hpp"
+#include "numeric.hpp"
+#include "profiler.hpp"
+#include "snapshot.hpp"
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+
+// Stack interpreter for Bytecode, specialized at compile time on one of the
+// backends in numeric.hpp and on a profiler from profiler.hpp. All variables
+// start at zero. A run can stop after any statement and continue later with
+// resume(), in this process or, through a snapshot file, in another one.
+template <typename Numeric, typename Profiler = NoProfiler>
+class Executor {
+public:
+    using Value = typename Numeric::Value;
+
+    // The bytecode is referenced, not copied, so it must outlive the
+    // Executor; temporaries are rejected.
+    Executor(const Bytecode& bytecode, Profiler profiler = Profiler());
+    Executor(Bytecode&&, Profiler = Profiler()) = delete;
+    void run();
+    void reset();
+    // Executes at most maxStatements further statements; true once the
+    // program has finished.
+    bool resume(size_t maxStatements = SIZE_MAX);
+    bool finished() const { return pc == bytecode.code.size(); }
+    size_t getStatement() const { return statement; }
+    vector<Value> getVariables() const { return vector<Value>(slots, slots + bytecode.symbols.size()); }
+    const Profiler& getProfiler() const { return profiler; }
+
+    // After loadSnapshot the variables live in the mapped file, copy-on-write,
+    // until the next reset().
+    void saveSnapshot(const string& path) const;
+    void loadSnapshot(const string& path);
+
+private:
+    const Bytecode& bytecode;
+    Profiler profiler;
+    vector<Value> constants;
+    vector<Value> variables;
+    vector<Value> stack;
+    unique_ptr<Snapshot> snapshot;
+    Value* slots;
+    size_t pc = 0;
+    size_t statement = 0;
+};
+
+template <typename Numeric, typename Profiler>
+Executor<Numeric, Profiler>::Executor(const Bytecode& bytecode, Profiler profiler)
+    : bytecode(bytecode), profiler(move(profiler)), variables(bytecode.symbols.size()), stack(bytecode.maxStackDepth),
+      slots(variables.data()) {
+    constants.reserve(bytecode.constants.size());
+    for (uint64_t constant : bytecode.constants) {
+        constants.push_back(Numeric::fromLiteral(constant));
+    }
+}
+
+template <typename Numeric, typename Profiler>
+void Executor<Numeric, Profiler>::run() {
+    reset();
+    profiler.runStart();
+    resume();
+}
+
+template <typename Numeric, typename Profiler>
+void Executor<Numeric, Profiler>::reset() {
+    snapshot.reset();
+    slots = variables.data();
+    fill(variables.begin(), variables.end(), Value());
+    pc = 0;
+    statement = 0;
+}
+
+// pc and statement advance at every STORE, so after a runtime error they
+// still point just past the last statement that completed.
+template <typename Numeric, typename Profiler>
+bool Executor<Numeric, Profiler>::resume(size_t maxStatements) {
+    const Instruction* instr = bytecode.code.data() + pc;
+    const Instruction* end = bytecode.code.data() + bytecode.code.size();
+    Value* sp = stack.data();
+    size_t executed = 0;
+
+    Value* variables = slots;
+    auto slot = [variables](int index) -> Value& { return variables[index]; };
+
+    for (; instr != end; ++instr) {
+        sp = executeInstruction<Numeric>(*instr, sp, constants.data(), slot);
+        if (instr->op == OpCode::Store) {
+            pc = instr + 1 - bytecode.code.data();
+            statement++;
+            executed++;
+        }
+        profiler.instruction(instr->op, sp - stack.data());
+        if (executed == maxStatements) break;
+    }
+    return finished();
+}
+
+template <typename Numeric, typename Profiler>
+void Executor<Numeric, Profiler>::saveSnapshot(const string& path) const {
+    writeSnapshot(path, bytecode, Numeric::name, slots, sizeof(Value), pc, statement);
+}
+
+template <typename Numeric, typename Profiler>
+void Executor<Numeric, Profiler>::loadSnapshot(const string& path) {
+    unique_ptr<Snapshot> loaded(new Snapshot(path, bytecode, Numeric::name, sizeof(Value)));
+    slots = static_cast<Value*>(loaded->slots());
+    pc = loaded->pc();
+    statement = loaded->statement();
+    snapshot = move(loaded);
+}
+
+#endif
@@ -0,0 +1,104 @@
+#include <sys/stat.h>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "scanner.hpp"
+#include "parser.hpp"
+
+using namespace std;
+
+// Coverage-guided fuzz target for the scanner and parser, built with
+// "make fuzz" (needs clang's libFuzzer). Every input is compiled once from
+// memory and once streamed in chunks whose size comes from the first byte,
+// both through feed() and through a parser pulling from the scanner; the
+// token lists must agree, and so must the parse results, RPN instructions
+// (operation, operand, constant and line) and constant pools. Each input
+// whose total time over all three passes is the slowest so far is saved to
+// slow-inputs/ so it can be replayed or turned into a stress class.
+// "make fuzz-replay" builds the same target with a main() that runs it on the
+// files named on the command line, without needing clang.
+
+static double slowestMs = 0;
+
+static void recordIfSlowest(const uint8_t* data, size_t size, double ms) {
+    if (ms <= slowestMs) return;
+    slowestMs = ms;
+    mkdir("slow-inputs", 0755);
+    string path = "slow-inputs/slow-" + to_string(static_cast<long>(ms * 1000)) + "us.in";
+    ofstream(path, ios::binary).write(reinterpret_cast<const char*>(data), size);
+}
+
+static bool sameTokens(const vector<Token>& a, const vector<Token>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].type != b[i].type || a[i].value != b[i].value || a[i].line != b[i].line ||
+            a[i].number != b[i].number) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool sameProgram(const Parser& a, const Parser& b) {
+    const vector<RPNInstruction>& x = a.getRPNInstructions();
+    const vector<RPNInstruction>& y = b.getRPNInstructions();
+    if (x.size() != y.size() || a.getConstants() != b.getConstants()) return false;
+    for (size_t i = 0; i < x.size(); i++) {
+        if (x[i].operation != y[i].operation || x[i].operand != y[i].operand || x[i].constant != y[i].constant ||
+            x[i].line != y[i].line) {
+            return false;
+        }
+    }
+    return true;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    string_view source(reinterpret_cast<const char*>(data), size);
+    ostringstream discard;
+    size_t chunkSize = size > 0 ? data[0] % 16 + 1 : 1;
+
+    auto begin = chrono::steady_clock::now();
+    Scanner scanner(source, discard);
+    vector<Token> tokens = scanner.scanTokens();
+    Parser parser(tokens, ParseMode::Full, discard);
+    bool parsed = parser.parse();
+
+    Scanner streaming(discard);
+    for (size_t offset = 0; offset < size; offset += chunkSize) {
+        streaming.feed(source.substr(offset, chunkSize));
+    }
+    vector<Token> streamedTokens = streaming.finish();
+
+    size_t offset = 0;
+    Scanner pulled([&](string& block) {
+        if (offset >= size) return false;
+        block.assign(source.substr(offset, chunkSize));
+        offset += block.size();
+        return true;
+    }, discard);
+    Parser pullingParser(pulled, ParseMode::Full, discard);
+    bool pulledParse = pullingParser.parse();
+    auto end = chrono::steady_clock::now();
+    recordIfSlowest(data, size, chrono::duration<double, milli>(end - begin).count());
+
+    if (!sameTokens(tokens, streamedTokens)) abort();
+    if (parsed != pulledParse || !sameProgram(parser, pullingParser)) abort();
+    return 0;
+}
+
+#ifdef FUZZ_REPLAY
+int main(int argc, char* argv[]) {
+    for (int i = 1; i < argc; i++) {
+        ifstream file(argv[i], ios::binary);
+        string content((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+        LLVMFuzzerTestOneInput(reinterpret_cast<const uint8_t*>(content.data()), content.size());
+        printf("%s: ok\n", argv[i]);
+    }
+    return 0;
+}
+#endif
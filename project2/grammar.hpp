@@ -0,0 +1,218 @@
+#ifndef GRAMMAR_HPP
+#define GRAMMAR_HPP
+
+#include <string_view>
+#include <cstdint>
+
+using namespace std;
+
+enum class TokenType {
+    Begin, End, Identifier, Number, Assign, Semicolon, Plus, Minus, Multiply, Divide, LeftParen, RightParen, Dot, Comment, Unknown, Eof, Var, Comma
+};
+
+// Lexical and syntactic rules of the language. Everything here is constexpr
+// so the runtime Scanner/Parser and the compile-time compiler in
+// embedded.hpp are built from the same definitions; Syntax below is the one
+// recursive-descent parser both of them run.
+namespace grammar {
+
+constexpr char commentStart = '~';
+
+constexpr bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+constexpr bool isAlpha(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+constexpr bool isAlphaNumeric(char c) {
+    return isAlpha(c) || isDigit(c);
+}
+
+constexpr bool isWhitespace(char c) {
+    return c == ' ' || c == '\r' || c == '\t' || c == '\n';
+}
+
+// Single-character tokens; Unknown if c does not start one.
+constexpr TokenType punctuation(char c) {
+    switch (c) {
+        case '(': return TokenType::LeftParen;
+        case ')': return TokenType::RightParen;
+        case ';': return TokenType::Semicolon;
+        case '.': return TokenType::Dot;
+        case '=': return TokenType::Assign;
+        case '+': return TokenType::Plus;
+        case '-': return TokenType::Minus;
+        case '*': return TokenType::Multiply;
+        case '/': return TokenType::Divide;
+        case ',': return TokenType::Comma;
+        default: return TokenType::Unknown;
+    }
+}
+
+constexpr TokenType keyword(string_view text) {
+    if (text == "begin") return TokenType::Begin;
+    if (text == "end") return TokenType::End;
+    if (text == "var") return TokenType::Var;
+    return TokenType::Identifier;
+}
+
+// Deepest parenthesis nesting Syntax accepts; the expression parser
+// recurses once per level, so this bounds its stack use.
+constexpr int maxNestingDepth = 1000;
+
+// Longest literal that can still fit in 64 bits.
+constexpr size_t maxNumberDigits = 20;
+
+// Decodes a run of decimal digits; false if the value does not fit in
+// 64 bits.
+constexpr bool decodeNumber(string_view digits, uint64_t& value) {
+    if (digits.size() > maxNumberDigits) return false;
+    uint64_t result = 0;
+    for (char c : digits) {
+        uint64_t digit = static_cast<uint64_t>(c - '0');
+        if (result > (UINT64_MAX - digit) / 10) return false;
+        result = result * 10 + digit;
+    }
+    value = result;
+    return true;
+}
+
+// Binary operators at each precedence level and their RPN mnemonics.
+constexpr bool isAdditive(TokenType type) {
+    return type == TokenType::Plus || type == TokenType::Minus;
+}
+
+constexpr bool isMultiplicative(TokenType type) {
+    return type == TokenType::Multiply || type == TokenType::Divide;
+}
+
+constexpr const char* operatorMnemonic(TokenType type) {
+    switch (type) {
+        case TokenType::Plus: return "PLUS";
+        case TokenType::Minus: return "MINUS";
+        case TokenType::Multiply: return "TIMES";
+        case TokenType::Divide: return "DIV";
+        default: return "";
+    }
+}
+
+// Returns the error message for an ill-formed identifier, or nullptr.
+constexpr const char* identifierError(string_view name) {
+    if (!name.empty() && name.back() == '_') {
+        return "Identifier cannot end with an underscore.";
+    }
+    for (size_t i = 0; i + 1 < name.size(); i++) {
+        if (name[i] == '_' && name[i + 1] == '_') {
+            return "Identifier cannot contain consecutive underscores.";
+        }
+    }
+    return nullptr;
+}
+
+// The grammar:
+//
+//   program     = "begin" { "var" declaration | assignment } "end" "."
+//   declaration = identifier { "," identifier } ";"
+//   assignment  = identifier "=" expression ";"
+//   expression  = term { ("+" | "-") term }
+//   term        = factor { ("*" | "/") factor }
+//   factor      = number | "(" expression ")" | identifier
+//
+// Host supplies the tokens and the meaning:
+//   check(type), match(type)   look at / consume the current token
+//   isAtEnd()                  whether the current token is Eof
+//   previousType()             type of the token just consumed
+//   syntaxError(message)       at the current token; must not return
+//   errorAtPrevious(message)   at the token just consumed; must not return
+//   declare()                  the identifier just consumed is declared
+//   target()                   the identifier just consumed is assigned to;
+//                              returns whatever store() needs
+//   store(target)              after the assigned expression
+//   number(), variable()       the operand just consumed
+//   binary(type)               after both operands of an operator
+template <typename Host>
+class Syntax {
+public:
+    constexpr explicit Syntax(Host& host) : host(host) {}
+
+    constexpr void program() {
+        expect(TokenType::Begin, "Expected 'begin' at the start of the program.");
+        while (!host.check(TokenType::End) && !host.isAtEnd()) {
+            if (host.match(TokenType::Var)) {
+                declaration();
+            } else if (host.check(TokenType::Identifier)) {
+                assignment();
+            } else {
+                host.syntaxError("Expected statement.");
+            }
+        }
+        expect(TokenType::End, "Expected 'end' after statements.");
+        expect(TokenType::Dot, "Expected '.' after 'end'");
+    }
+
+private:
+    Host& host;
+    int nestingDepth = 0;
+
+    constexpr void expect(TokenType type, const char* message) {
+        if (!host.match(type)) host.syntaxError(message);
+    }
+
+    constexpr void declaration() {
+        do {
+            expect(TokenType::Identifier, "Expected variable name.");
+            host.declare();
+        } while (host.match(TokenType::Comma));
+        expect(TokenType::Semicolon, "Expected ';' after variable declaration.");
+    }
+
+    constexpr void assignment() {
+        expect(TokenType::Identifier, "Expected identifier.");
+        auto target = host.target();
+        expect(TokenType::Assign, "Expected '=' after identifier.");
+        expression();
+        host.store(target);
+        expect(TokenType::Semicolon, "Expected ';' after expression.");
+    }
+
+    constexpr void expression() {
+        term();
+        while (host.match(TokenType::Plus) || host.match(TokenType::Minus)) {
+            TokenType op = host.previousType();
+            term();
+            host.binary(op);
+        }
+    }
+
+    constexpr void term() {
+        factor();
+        while (host.match(TokenType::Multiply) || host.match(TokenType::Divide)) {
+            TokenType op = host.previousType();
+            factor();
+            host.binary(op);
+        }
+    }
+
+    constexpr void factor() {
+        if (host.match(TokenType::Number)) {
+            host.number();
+        } else if (host.match(TokenType::LeftParen)) {
+            if (++nestingDepth > maxNestingDepth) {
+                host.errorAtPrevious("Expression nested too deeply.");
+            }
+            expression();
+            expect(TokenType::RightParen, "Expected ')'.");
+            nestingDepth--;
+        } else if (host.match(TokenType::Identifier)) {
+            host.variable();
+        } else {
+            host.syntaxError("Expected expression.");
+        }
+    }
+};
+
+}
+
+#endif
@@ -2,8 +2,17 @@
 #include <iostream>
 #include <sstream>
 #include <vector>
+#include <cstdlib>
+#include <cstring>
 #include "scanner.hpp"
 #include "parser.hpp"
+#include "bytecode.hpp"
+#include "executor.hpp"
+#include "regvm.hpp"
+#include "optimizer.hpp"
+#include "batchio.hpp"
+#include "compression.hpp"
+#include "module.hpp"
 
 using namespace std;
 
@@ -21,52 +30,478 @@ string readFile(const string& filePath) {
     }
 }
 
-void processFile(const string& filePath) {
-    string fileContent = readFile(filePath);
+struct Options {
+    string numericType;
+    bool registerVM = false;
+    bool reassociate = false;
+    int profileRuns = 0;
+    Compression outputCompression = Compression::None;
+    ModuleLinker* linker = nullptr;
+    string snapshotPath;
+    string resumePath;
+    size_t statementLimit = SIZE_MAX;
+};
 
-    if (!fileContent.empty()) {
-        cout << "Processing file: " << filePath << endl;
-        Scanner scanner(fileContent);
-        vector<Token> tokens = scanner.scanTokens();
-
-        Parser parser(tokens);
-        bool success = parser.parse();
-
-        if (success) {
-            cout << "Success! Parsing completed successfully for file " << filePath << endl;
-            string outputFileName = filePath.substr(13) + ".rpn";
-            parser.outputRPNInstructions(outputFileName);
-            cout << "RPN code generated and stored in: " << outputFileName << endl;
+template <typename Value>
+void printVariables(const string& engine, const char* numericName, const vector<string>& symbols, const vector<Value>& variables) {
+    cout << "Execution finished on the " << engine << " using " << numericName << " values:" << endl;
+    for (size_t i = 0; i < variables.size(); i++) {
+        cout << "  " << symbols[i] << " = " << variables[i] << endl;
+    }
+}
+
+string outputFileName(const string& filePath, const string& extension) {
+    size_t slash = filePath.find_last_of('/');
+    return (slash == string::npos ? filePath : filePath.substr(slash + 1)) + extension;
+}
+
+#ifdef ENABLE_PROFILING
+template <typename Numeric>
+void profileExecutor(const Bytecode& bytecode, const Options& options, const string& filePath) {
+    Executor<Numeric, ExecutionProfiler> executor(bytecode, ExecutionProfiler(bytecode));
+    for (int i = 0; i < options.profileRuns; i++) {
+        executor.run();
+    }
+    printVariables("stack VM", Numeric::name, bytecode.symbols, executor.getVariables());
+    executor.getProfiler().report(cout);
+
+    string foldedFileName = outputFileName(filePath, ".folded");
+    ofstream folded(foldedFileName);
+    executor.getProfiler().writeFoldedStacks(folded, outputFileName(filePath, ""));
+    cout << "Folded stacks stored in: " << foldedFileName << endl;
+}
+#endif
+
+template <typename Numeric>
+void runExecutor(const Bytecode& bytecode, const Options& options, const string& filePath) {
+    try {
+#ifdef ENABLE_PROFILING
+        if (options.profileRuns > 0) {
+            profileExecutor<Numeric>(bytecode, options, filePath);
+            return;
+        }
+#endif
+        if (options.registerVM) {
+            RegisterProgram program = lowerToRegisters(bytecode);
+            RegisterVM<Numeric> vm(program);
+            vm.run();
+            printVariables("register VM", Numeric::name, program.symbols, vm.getVariables());
         } else {
-            cout << "Unsuccessful! Parsing encountered errors for file " << filePath << endl;
+            Executor<Numeric> executor(bytecode);
+            if (!options.resumePath.empty()) {
+                executor.loadSnapshot(options.resumePath);
+                cout << "Resumed from " << options.resumePath << " after statement " << executor.getStatement() << endl;
+            }
+            bool finished = executor.resume(options.statementLimit);
+            if (!options.snapshotPath.empty()) {
+                executor.saveSnapshot(options.snapshotPath);
+                cout << "Snapshot after statement " << executor.getStatement() << " stored in: " << options.snapshotPath << endl;
+            }
+            if (!finished) {
+                cout << "Stopped after statement " << executor.getStatement() << endl;
+            }
+            printVariables("stack VM", Numeric::name, bytecode.symbols, executor.getVariables());
+        }
+    } catch (const runtime_error& error) {
+        cout << "Execution error: " << error.what() << endl;
+    }
+}
+
+void executeProgram(const Bytecode& bytecode, const Options& options, const string& filePath) {
+    if (options.numericType == "int32") runExecutor<Int32Numeric>(bytecode, options, filePath);
+    else if (options.numericType == "int64") runExecutor<Int64Numeric>(bytecode, options, filePath);
+    else if (options.numericType == "double") runExecutor<DoubleNumeric>(bytecode, options, filePath);
+    else if (options.numericType == "checked") runExecutor<CheckedInt64Numeric>(bytecode, options, filePath);
+}
+
+// Writes the RPN straight to disk, or queues it on batch when one is given;
+// with --compress-output it is compressed in memory first either way.
+// Output files are named after the input without its compression suffix.
+void compileParsed(const string& filePath, Parser& parser, bool success, const Options& options, FileBatch* batch,
+                   Compression inputCompression = Compression::None) {
+    if (success) {
+        cout << "Success! Parsing completed successfully for file " << filePath << endl;
+        string baseName = stripCompressionSuffix(filePath, inputCompression);
+        string rpnFileName = outputFileName(baseName, ".rpn");
+        if (options.outputCompression != Compression::None) {
+            rpnFileName += compressionSuffix(options.outputCompression);
+            stringstream rpn;
+            parser.writeRPNInstructions(rpn);
+            try {
+                if (batch != nullptr) {
+                    batch->write(rpnFileName, compressData(rpn.str(), options.outputCompression));
+                } else {
+                    writeCompressedFile(rpnFileName, rpn.str(), options.outputCompression);
+                }
+            } catch (const runtime_error& error) {
+                cerr << error.what() << endl;
+            }
+        } else if (batch != nullptr) {
+            stringstream rpn;
+            parser.writeRPNInstructions(rpn);
+            batch->write(rpnFileName, rpn.str());
+        } else {
+            parser.outputRPNInstructions(rpnFileName);
+        }
+        // Batch writes are only confirmed by flush(), after every file.
+        cout << "RPN code generated and " << (batch != nullptr ? "queued for: " : "stored in: ") << rpnFileName << endl;
+        if (!options.numericType.empty() || options.linker != nullptr) {
+            Bytecode bytecode = compileBytecode(parser.getRPNInstructions(), parser.getConstants());
+            if (options.reassociate) {
+                bytecode = reassociate(bytecode);
+            }
+            if (options.linker != nullptr) {
+                try {
+                    // Programs are named like their .rpn output: file name only.
+                    options.linker->add(outputFileName(baseName, ""), bytecode);
+                } catch (const runtime_error& error) {
+                    cout << error.what() << endl;
+                }
+            }
+            if (!options.numericType.empty()) {
+                executeProgram(bytecode, options, baseName);
+            }
+        }
+    } else {
+        cout << "Unsuccessful! Parsing encountered errors for file " << filePath << endl;
+    }
+    cout << endl;
+}
+
+void compileFile(const string& filePath, const string& fileContent, const Options& options, FileBatch* batch) {
+    cout << "Processing file: " << filePath << endl;
+    Scanner scanner(fileContent);
+    vector<Token> tokens = scanner.scanTokens();
+    Parser parser(tokens);
+    bool success = parser.parse();
+    compileParsed(filePath, parser, success, options, batch);
+}
+
+// The parser pulls decompressed blocks through the scanner while the reader
+// decompresses the next one, so neither the input nor its tokens are ever
+// held in memory whole. A decompression error ends the input early; it is
+// reported after the parse and the file is not compiled.
+void compileBlocks(const string& filePath, unique_ptr<BlockReader> reader, Compression compression, const Options& options,
+                   FileBatch* batch) {
+    string first;
+    string readError;
+    try {
+        if (!reader->next(first)) {
+            cout << "Skipping empty or non-existent file: " << filePath << endl << endl;
+            return;
         }
-        cout << endl;
+    } catch (const runtime_error& error) {
+        readError = error.what();
+    }
+    if (readError.empty()) {
+        cout << "Processing file: " << filePath << " (" << compressionName(compression) << ")" << endl;
+    }
+    bool firstBlock = true;
+    Scanner scanner([&](string& block) {
+        if (firstBlock) {
+            firstBlock = false;
+            block = move(first);
+            return readError.empty();
+        }
+        try {
+            return readError.empty() && reader->next(block);
+        } catch (const runtime_error& error) {
+            readError = error.what();
+            return false;
+        }
+    });
+    Parser parser(scanner);
+    bool success = parser.parse();
+    // Scan whatever the parser left, so every scanner diagnostic is reported
+    // as it is for uncompressed input.
+    vector<Token> rest;
+    while (scanner.scanMore(rest)) rest.clear();
+
+    if (!readError.empty()) {
+        cerr << readError << endl;
+        cout << "Unsuccessful! Could not decompress file " << filePath << endl << endl;
+        return;
+    }
+    compileParsed(filePath, parser, success, options, batch, compression);
+}
+
+// content holds the compressed file when it has already been read, so it is
+// decompressed from memory instead of being read a second time.
+void processCompressedFile(const string& filePath, Compression compression, const Options& options, FileBatch* batch,
+                           string content = string()) {
+    unique_ptr<BlockReader> reader;
+    try {
+        reader = content.empty() ? openBlockReader(filePath, compression) : openMemoryBlockReader(move(content), compression);
+    } catch (const runtime_error& error) {
+        cerr << error.what() << endl;
+        cout << "Unsuccessful! Could not decompress file " << filePath << endl << endl;
+        return;
+    }
+    compileBlocks(filePath, move(reader), compression, options, batch);
+}
+
+void processFile(const string& filePath, const Options& options) {
+    Compression compression = detectFileCompression(filePath);
+    if (compression != Compression::None) {
+        processCompressedFile(filePath, compression, options, nullptr);
+        return;
+    }
+
+    string fileContent = readFile(filePath);
+
+    if (!fileContent.empty()) {
+        compileFile(filePath, fileContent, options, nullptr);
     } else {
         cout << "Skipping empty or non-existent file: " << filePath << endl << endl;
     }
 }
 
+// Keeps up to readAhead files being read while the current one compiles,
+// and never waits for an .rpn write until every file has been processed.
+// Returns false when any .rpn file could not be written.
+bool processBatch(const vector<string>& filePaths, const Options& options) {
+    const size_t readAhead = 32;
+    unique_ptr<FileBatch> batch = createFileBatch();
+    cout << "Batch I/O backend: " << batch->name() << endl << endl;
 
-int main(int argc, char* argv[]) {
-    if (argc != 2) {
-        cerr << "Usage: " << argv[0] << " <filename>|all" << endl;
+    size_t queued = 0;
+    for (; queued < filePaths.size() && queued < readAhead; queued++) {
+        batch->prefetch(filePaths[queued]);
+    }
+
+    for (size_t i = 0; i < filePaths.size(); i++) {
+        BatchRead read = batch->next();
+        if (queued < filePaths.size()) {
+            batch->prefetch(filePaths[queued++]);
+        }
+
+        if (!read.ok) {
+            cerr << "Could not open file: " << read.path << endl;
+        }
+        Compression compression = detectCompression(read.content);
+        if (compression != Compression::None) {
+            processCompressedFile(read.path, compression, options, batch.get(), move(read.content));
+        } else if (!read.content.empty()) {
+            compileFile(read.path, read.content, options, batch.get());
+        } else {
+            cout << "Skipping empty or non-existent file: " << read.path << endl << endl;
+        }
+    }
+    vector<BatchWriteError> failures;
+    try {
+        failures = batch->flush();
+    } catch (const runtime_error& error) {
+        cerr << error.what() << endl;
+        return false;
+    }
+    for (const auto& failure : failures) {
+        cerr << "Unable to write RPN instructions: " << failure.path << " (" << strerror(failure.error) << ")" << endl;
+    }
+    if (failures.empty()) {
+        cout << "All RPN files written" << endl;
+    }
+    return failures.empty();
+}
+
+void writeModule(const ModuleLinker& linker, const string& modulePath) {
+    vector<uint8_t> bytes = linker.link();
+    ofstream file(modulePath, ios::binary);
+    file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    if (!file) {
+        cerr << "Unable to write module: " << modulePath << endl;
+        return;
+    }
+    cout << "Linked " << linker.programCount() << " programs into " << modulePath << " (" << bytes.size() << " bytes): "
+         << linker.sequenceCount() << " distinct statements of " << linker.statementCount() << ", "
+         << linker.symbolCount() << " symbols, " << linker.constantCount() << " constants" << endl;
+}
+
+template <typename Numeric>
+void runModuleProgram(const Module& module, ModuleExecutor<Numeric>& executor, size_t program, const Options& options) {
+    string name(module.programName(program));
+    cout << "Program " << name << ":" << endl;
+    if (options.registerVM || options.profileRuns > 0) {
+        runExecutor<Numeric>(module.toBytecode(program), options, name);
+        return;
+    }
+    try {
+        executor.run(program);
+        vector<string> symbols;
+        for (uint32_t i = 0; i < module.program(program).variableCount; i++) {
+            symbols.emplace_back(module.symbol(module.programVariables(program)[i]));
+        }
+        printVariables("module VM", Numeric::name, symbols, executor.getVariables(program));
+    } catch (const runtime_error& error) {
+        cout << "Execution error: " << error.what() << endl;
+    }
+}
+
+// Runs the named programs of a mapped module, or all of them when no names
+// are given.
+template <typename Numeric>
+void runModule(const Module& module, const vector<string>& programNames, const Options& options) {
+    ModuleExecutor<Numeric> executor(module);
+    if (programNames.empty()) {
+        for (size_t i = 0; i < module.programCount(); i++) {
+            runModuleProgram(module, executor, i, options);
+        }
+        return;
+    }
+    for (const auto& name : programNames) {
+        int program = module.findProgram(name);
+        if (program < 0) {
+            cout << "No program " << name << " in module" << endl;
+        } else {
+            runModuleProgram(module, executor, program, options);
+        }
+    }
+}
+
+int processModule(const string& modulePath, const vector<string>& programNames, const Options& options) {
+    try {
+        Module module(modulePath);
+        cout << "Loaded module " << modulePath << ": " << module.programCount() << " programs, "
+             << module.sequenceCount() << " distinct statements" << endl;
+        if (options.numericType == "int32") runModule<Int32Numeric>(module, programNames, options);
+        else if (options.numericType == "int64") runModule<Int64Numeric>(module, programNames, options);
+        else if (options.numericType == "double") runModule<DoubleNumeric>(module, programNames, options);
+        else if (options.numericType == "checked") runModule<CheckedInt64Numeric>(module, programNames, options);
+    } catch (const runtime_error& error) {
+        cerr << error.what() << endl;
         return 1;
     }
+    return 0;
+}
 
-    if (string(argv[1]) == "all") {
+void usage(const char* program) {
+    cerr << "Usage: " << program << " [--exec=int32|int64|double|checked] [--regvm] [--reassociate] [--profile[=runs]] [--compress-output=gzip|zstd] <filename>|all" << endl;
+    cerr << "       " << program << " --batch [options] <filename>...|all" << endl;
+    cerr << "       " << program << " --link=<module> [options] <filename>...|all" << endl;
+    cerr << "       " << program << " --module=<module> [--exec=...] [--regvm] [program...]" << endl;
+    cerr << "       " << program << " [--exec=...] [--resume=<snapshot>] [--stop-after=statements] [--snapshot=<snapshot>] <filename>" << endl;
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    bool batchMode = false;
+    bool allFiles = false;
+    string linkPath;
+    string modulePath;
+    vector<string> filePaths;
+
+    for (int argIndex = 1; argIndex < argc; argIndex++) {
+        string option = argv[argIndex];
+        if (option.rfind("--exec=", 0) == 0) {
+            options.numericType = option.substr(7);
+            if (options.numericType != "int32" && options.numericType != "int64" &&
+                options.numericType != "double" && options.numericType != "checked") {
+                cerr << "Unknown numeric type: " << options.numericType << " (expected int32, int64, double or checked)" << endl;
+                return 1;
+            }
+        } else if (option == "--regvm") {
+            options.registerVM = true;
+        } else if (option == "--reassociate") {
+            options.reassociate = true;
+        } else if (option.rfind("--compress-output=", 0) == 0) {
+            string method = option.substr(18);
+            options.outputCompression = method == "gzip" ? Compression::Gzip : method == "zstd" ? Compression::Zstd : Compression::None;
+            if (options.outputCompression == Compression::None || !compressionSupported(options.outputCompression)) {
+                cerr << "Unsupported output compression: " << method << endl;
+                return 1;
+            }
+        } else if (option.rfind("--link=", 0) == 0) {
+            linkPath = option.substr(7);
+        } else if (option.rfind("--module=", 0) == 0) {
+            modulePath = option.substr(9);
+        } else if (option.rfind("--snapshot=", 0) == 0) {
+            options.snapshotPath = option.substr(11);
+        } else if (option.rfind("--resume=", 0) == 0) {
+            options.resumePath = option.substr(9);
+        } else if (option.rfind("--stop-after=", 0) == 0) {
+            long long statements = atoll(option.c_str() + 13);
+            if (statements < 1) {
+                cerr << "The number of statements must be positive" << endl;
+                return 1;
+            }
+            options.statementLimit = static_cast<size_t>(statements);
+        } else if (option == "--batch") {
+            batchMode = true;
+        } else if (option == "--profile" || option.rfind("--profile=", 0) == 0) {
+#ifdef ENABLE_PROFILING
+            options.profileRuns = option == "--profile" ? 1 : atoi(option.c_str() + 10);
+            if (options.profileRuns < 1) {
+                cerr << "The number of profiled runs must be positive" << endl;
+                return 1;
+            }
+#else
+            cerr << "Profiling is not compiled in; rebuild with make PROFILE=1" << endl;
+            return 1;
+#endif
+        } else if (option.rfind("--", 0) == 0) {
+            usage(argv[0]);
+            return 1;
+        } else if (option == "all") {
+            allFiles = true;
+        } else {
+            filePaths.push_back(option);
+        }
+    }
+    if (options.registerVM && options.profileRuns > 0) {
+        cerr << "--profile runs on the stack VM and cannot be combined with --regvm" << endl;
+        return 1;
+    }
+    if (options.reassociate && (options.numericType == "double" || options.numericType == "checked")) {
+        cerr << "--reassociate is only exact for int32 and int64 and cannot be used with --exec=" << options.numericType << endl;
+        return 1;
+    }
+    bool snapshots = !options.snapshotPath.empty() || !options.resumePath.empty() || options.statementLimit != SIZE_MAX;
+    if (snapshots && (options.registerVM || options.profileRuns > 0 || !modulePath.empty() || !linkPath.empty())) {
+        cerr << "Snapshots are taken on the stack VM and cannot be combined with --regvm, --profile, --link or --module" << endl;
+        return 1;
+    }
+    // "all" names every program of a module, and otherwise the sample inputs.
+    if (allFiles && modulePath.empty()) {
         vector<string> filenames = {
             "a1.in", "a2.in", "a3.in", "a4.in",
             "a5.in", "a6.in", "a7.in", "a8.in"
         };
-        
         for (const auto& filename : filenames) {
-            string filePath = "inputFilesP2/" + filename;
-            processFile(filePath);
+            filePaths.push_back("inputFilesP2/" + filename);
         }
+    }
+    if (snapshots && filePaths.size() != 1) {
+        cerr << "--snapshot, --resume and --stop-after take a single input file" << endl;
+        return 1;
+    }
+    if (!modulePath.empty()) {
+        if (options.numericType.empty()) options.numericType = "int64";
+        if (allFiles) filePaths.clear();
+        return processModule(modulePath, filePaths, options);
+    }
+    bool manyFiles = batchMode || !linkPath.empty() || allFiles;
+    if (filePaths.empty() || (!manyFiles && filePaths.size() != 1)) {
+        usage(argv[0]);
+        return 1;
+    }
+    if ((options.registerVM || options.reassociate || options.profileRuns > 0 || snapshots) && options.numericType.empty()) {
+        options.numericType = "int64";
+    }
+
+    ModuleLinker linker;
+    if (!linkPath.empty()) {
+        options.linker = &linker;
+    }
+    int status = 0;
+    if (batchMode) {
+        if (!processBatch(filePaths, options)) status = 1;
     } else {
-        string filePath = argv[1];
-        processFile(filePath);
+        for (const auto& filePath : filePaths) {
+            processFile(filePath, options);
+        }
+    }
+    if (!linkPath.empty()) {
+        writeModule(linker, linkPath);
     }
 
-    return 0;
+    return status;
 }
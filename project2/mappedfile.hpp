@@ -0,0 +1,34 @@
+#ifndef MAPPEDFILE_HPP
+#define MAPPEDFILE_HPP
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+// Internal helpers for the module and snapshot files, which are built as
+// 8-byte aligned sections and mapped straight back into memory.
+
+// The records are mapped as they are, so only little-endian hosts can read
+// them; what names the file kind in the error ("Modules", "Snapshots").
+inline void requireLittleEndian(const char* what) {
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+    throw runtime_error(string(what) + " are only supported on little-endian hosts");
+#else
+    (void)what;
+#endif
+}
+
+// Appends size bytes at data to bytes, 8-byte aligned, and returns their
+// offset. Bytes is a string or a vector<uint8_t>.
+template <typename Bytes>
+uint64_t appendSection(Bytes& bytes, const void* data, size_t size) {
+    bytes.resize((bytes.size() + 7) & ~size_t(7));
+    uint64_t offset = bytes.size();
+    const char* begin = static_cast<const char*>(data);
+    bytes.insert(bytes.end(), begin, begin + size);
+    return offset;
+}
+
+#endif
@@ -0,0 +1,316 @@
+#include "module.hpp"
+#include "mappedfile.hpp"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+#include <type_traits>
+
+static_assert(sizeof(Instruction) == 8 && is_standard_layout<Instruction>::value,
+              "module code is mapped directly as Instruction records");
+
+namespace {
+
+const uint32_t moduleVersion = 1;
+
+}
+
+uint32_t ModuleLinker::internSymbol(const string& name) {
+    auto it = symbolIndex.find(name);
+    if (it != symbolIndex.end()) return it->second;
+    uint32_t index = static_cast<uint32_t>(symbols.size());
+    symbolIndex.emplace(name, index);
+    symbols.push_back(name);
+    return index;
+}
+
+uint32_t ModuleLinker::internConstant(uint64_t value) {
+    auto it = constantIndex.find(value);
+    if (it != constantIndex.end()) return it->second;
+    uint32_t index = static_cast<uint32_t>(constants.size());
+    constantIndex.emplace(value, index);
+    constants.push_back(value);
+    return index;
+}
+
+// Statements are hash-consed on their code bytes, which only mean the same
+// thing in two programs because operands are already global.
+uint32_t ModuleLinker::internSequence(const vector<Instruction>& statement) {
+    string key(reinterpret_cast<const char*>(statement.data()), statement.size() * sizeof(Instruction));
+    auto it = sequenceIndex.find(key);
+    if (it != sequenceIndex.end()) return it->second;
+
+    uint32_t depth = 0;
+    uint32_t maxDepth = 0;
+    for (const auto& instr : statement) {
+        if (instr.op == OpCode::Num || instr.op == OpCode::Rval) {
+            maxDepth = max(maxDepth, ++depth);
+        } else {
+            depth--;
+        }
+    }
+    uint32_t index = static_cast<uint32_t>(sequences.size());
+    sequences.push_back({static_cast<uint32_t>(code.size()), static_cast<uint32_t>(statement.size()), maxDepth});
+    code.insert(code.end(), statement.begin(), statement.end());
+    sequenceIndex.emplace(move(key), index);
+    maxStackDepth = max(maxStackDepth, maxDepth);
+    return index;
+}
+
+void ModuleLinker::add(const string& name, const Bytecode& bytecode) {
+    if (programIndex.count(name) != 0) throw runtime_error("Duplicate program in module: " + name);
+    // Statements are split at each STORE, so code after the last one would
+    // be dropped silently.
+    if (!bytecode.code.empty() && bytecode.code.back().op != OpCode::Store) {
+        throw runtime_error("Program does not end with a STORE: " + name);
+    }
+
+    Program program;
+    program.name = name;
+    for (const auto& symbol : bytecode.symbols) {
+        program.variables.push_back(internSymbol(symbol));
+    }
+    vector<uint32_t> constantMap;
+    for (uint64_t constant : bytecode.constants) {
+        constantMap.push_back(internConstant(constant));
+    }
+
+    vector<Instruction> statement;
+    for (const auto& instr : bytecode.code) {
+        int operand = instr.operand;
+        if (instr.op == OpCode::Num) operand = static_cast<int>(constantMap[operand]);
+        if (instr.op == OpCode::Rval || instr.op == OpCode::Store) operand = static_cast<int>(program.variables[operand]);
+        statement.push_back({instr.op, operand});
+        if (instr.op == OpCode::Store) {
+            program.statements.push_back(internSequence(statement));
+            size_t index = program.lines.size();
+            int line = index < bytecode.statementLines.size() ? bytecode.statementLines[index] : 0;
+            program.lines.push_back(static_cast<uint32_t>(line));
+            statement.clear();
+        }
+    }
+    statements += program.statements.size();
+    programIndex.emplace(name, programs.size());
+    programs.push_back(move(program));
+}
+
+vector<uint8_t> ModuleLinker::link() const {
+    requireLittleEndian("Modules");
+    vector<size_t> order(programs.size());
+    iota(order.begin(), order.end(), 0);
+    sort(order.begin(), order.end(), [&](size_t a, size_t b) { return programs[a].name < programs[b].name; });
+
+    string strings;
+    auto addString = [&](const string& value) {
+        ModuleString entry = {static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(value.size())};
+        strings += value;
+        return entry;
+    };
+    vector<ModuleString> symbolEntries;
+    for (const auto& symbol : symbols) symbolEntries.push_back(addString(symbol));
+
+    vector<ModuleProgram> programEntries;
+    vector<uint32_t> statementEntries, lineEntries, variableEntries;
+    for (size_t index : order) {
+        const Program& program = programs[index];
+        programEntries.push_back({addString(program.name),
+                                  static_cast<uint32_t>(statementEntries.size()), static_cast<uint32_t>(program.statements.size()),
+                                  static_cast<uint32_t>(variableEntries.size()), static_cast<uint32_t>(program.variables.size())});
+        statementEntries.insert(statementEntries.end(), program.statements.begin(), program.statements.end());
+        lineEntries.insert(lineEntries.end(), program.lines.begin(), program.lines.end());
+        variableEntries.insert(variableEntries.end(), program.variables.begin(), program.variables.end());
+    }
+
+    ModuleHeader header = {};
+    memcpy(header.magic, "RPNM", 4);
+    header.version = moduleVersion;
+    header.programCount = static_cast<uint32_t>(programEntries.size());
+    header.statementCount = static_cast<uint32_t>(statementEntries.size());
+    header.variableCount = static_cast<uint32_t>(variableEntries.size());
+    header.sequenceCount = static_cast<uint32_t>(sequences.size());
+    header.codeCount = static_cast<uint32_t>(code.size());
+    header.constantCount = static_cast<uint32_t>(constants.size());
+    header.symbolCount = static_cast<uint32_t>(symbolEntries.size());
+    header.stringBytes = static_cast<uint32_t>(strings.size());
+    header.maxStackDepth = maxStackDepth;
+
+    vector<uint8_t> bytes(sizeof(ModuleHeader));
+    header.programsOffset = appendSection(bytes, programEntries.data(), programEntries.size() * sizeof(programEntries[0]));
+    header.statementsOffset = appendSection(bytes, statementEntries.data(), statementEntries.size() * sizeof(statementEntries[0]));
+    header.linesOffset = appendSection(bytes, lineEntries.data(), lineEntries.size() * sizeof(lineEntries[0]));
+    header.variablesOffset = appendSection(bytes, variableEntries.data(), variableEntries.size() * sizeof(variableEntries[0]));
+    header.sequencesOffset = appendSection(bytes, sequences.data(), sequences.size() * sizeof(sequences[0]));
+    header.codeOffset = appendSection(bytes, code.data(), code.size() * sizeof(code[0]));
+    header.constantsOffset = appendSection(bytes, constants.data(), constants.size() * sizeof(constants[0]));
+    header.symbolsOffset = appendSection(bytes, symbolEntries.data(), symbolEntries.size() * sizeof(symbolEntries[0]));
+    header.stringsOffset = appendSection(bytes, strings.data(), strings.size());
+    memcpy(bytes.data(), &header, sizeof(header));
+    return bytes;
+}
+
+Module::Module(const string& path) {
+    requireLittleEndian("Modules");
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw runtime_error("Could not open module: " + path);
+    struct stat status;
+    if (fstat(fd, &status) != 0 || status.st_size < static_cast<off_t>(sizeof(ModuleHeader))) {
+        close(fd);
+        throw runtime_error("Malformed module: truncated");
+    }
+    size = static_cast<size_t>(status.st_size);
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) throw runtime_error("Could not map module: " + path);
+    data = static_cast<const uint8_t*>(mapping);
+
+    try {
+        validate();
+    } catch (...) {
+        munmap(const_cast<uint8_t*>(data), size);
+        throw;
+    }
+}
+
+Module::~Module() {
+    munmap(const_cast<uint8_t*>(data), size);
+}
+
+// Checks every section bound, index and statement once, so that running a
+// program afterwards needs no checks.
+void Module::validate() {
+    header = reinterpret_cast<const ModuleHeader*>(data);
+    if (memcmp(header->magic, "RPNM", 4) != 0) throw runtime_error("Malformed module: bad magic");
+    if (header->version != moduleVersion) throw runtime_error("Unsupported module version");
+
+    auto section = [&](uint64_t offset, uint64_t count, size_t recordSize) {
+        if (offset % 8 != 0 || offset > size || count * recordSize > size - offset) {
+            throw runtime_error("Malformed module: section out of bounds");
+        }
+        return data + offset;
+    };
+    programs = reinterpret_cast<const ModuleProgram*>(section(header->programsOffset, header->programCount, sizeof(ModuleProgram)));
+    statements = reinterpret_cast<const uint32_t*>(section(header->statementsOffset, header->statementCount, sizeof(uint32_t)));
+    lines = reinterpret_cast<const uint32_t*>(section(header->linesOffset, header->statementCount, sizeof(uint32_t)));
+    variables = reinterpret_cast<const uint32_t*>(section(header->variablesOffset, header->variableCount, sizeof(uint32_t)));
+    sequences = reinterpret_cast<const ModuleSequence*>(section(header->sequencesOffset, header->sequenceCount, sizeof(ModuleSequence)));
+    code = reinterpret_cast<const Instruction*>(section(header->codeOffset, header->codeCount, sizeof(Instruction)));
+    constants = reinterpret_cast<const uint64_t*>(section(header->constantsOffset, header->constantCount, sizeof(uint64_t)));
+    symbols = reinterpret_cast<const ModuleString*>(section(header->symbolsOffset, header->symbolCount, sizeof(ModuleString)));
+    strings = reinterpret_cast<const char*>(section(header->stringsOffset, header->stringBytes, 1));
+
+    auto checkString = [&](const ModuleString& string) {
+        if (uint64_t(string.offset) + string.length > header->stringBytes) {
+            throw runtime_error("Malformed module: string out of bounds");
+        }
+    };
+    for (uint32_t i = 0; i < header->symbolCount; i++) checkString(symbols[i]);
+
+    for (uint32_t i = 0; i < header->programCount; i++) {
+        const ModuleProgram& entry = programs[i];
+        checkString(entry.name);
+        if (uint64_t(entry.firstStatement) + entry.statementCount > header->statementCount ||
+            uint64_t(entry.firstVariable) + entry.variableCount > header->variableCount) {
+            throw runtime_error("Malformed module: program out of bounds");
+        }
+        if (i > 0 && !(programName(i - 1) < programName(i))) {
+            throw runtime_error("Malformed module: program index not sorted");
+        }
+    }
+    for (uint32_t i = 0; i < header->statementCount; i++) {
+        if (statements[i] >= header->sequenceCount) throw runtime_error("Malformed module: bad statement");
+    }
+    for (uint32_t i = 0; i < header->variableCount; i++) {
+        if (variables[i] >= header->symbolCount) throw runtime_error("Malformed module: bad variable");
+    }
+
+    // Each statement must push its operands, leave one value and end with
+    // the STORE that consumes it, within its recorded stack depth.
+    uint32_t moduleDepth = 0;
+    for (uint32_t i = 0; i < header->sequenceCount; i++) {
+        const ModuleSequence& entry = sequences[i];
+        if (entry.codeLength == 0 || uint64_t(entry.codeOffset) + entry.codeLength > header->codeCount) {
+            throw runtime_error("Malformed module: sequence out of bounds");
+        }
+        uint32_t depth = 0;
+        uint32_t maxDepth = 0;
+        for (uint32_t pc = 0; pc < entry.codeLength; pc++) {
+            uint32_t op;
+            memcpy(&op, &code[entry.codeOffset + pc].op, sizeof(op));
+            uint32_t operand = static_cast<uint32_t>(code[entry.codeOffset + pc].operand);
+            bool last = pc + 1 == entry.codeLength;
+            if (op > static_cast<uint32_t>(OpCode::Div)) throw runtime_error("Malformed module: bad opcode");
+            switch (static_cast<OpCode>(op)) {
+                case OpCode::Num:
+                    if (operand >= header->constantCount) throw runtime_error("Malformed module: bad constant");
+                    maxDepth = max(maxDepth, ++depth);
+                    break;
+                case OpCode::Rval:
+                    if (operand >= header->symbolCount) throw runtime_error("Malformed module: bad symbol");
+                    maxDepth = max(maxDepth, ++depth);
+                    break;
+                case OpCode::Store:
+                    if (operand >= header->symbolCount) throw runtime_error("Malformed module: bad symbol");
+                    if (!last || depth != 1) throw runtime_error("Malformed module: unbalanced statement");
+                    depth--;
+                    break;
+                default:
+                    if (depth < 2) throw runtime_error("Malformed module: stack underflow");
+                    depth--;
+            }
+            if (last && static_cast<OpCode>(op) != OpCode::Store) throw runtime_error("Malformed module: unterminated statement");
+        }
+        if (maxDepth != entry.maxStackDepth) throw runtime_error("Malformed module: wrong stack depth");
+        moduleDepth = max(moduleDepth, maxDepth);
+    }
+    if (moduleDepth != header->maxStackDepth) throw runtime_error("Malformed module: wrong stack depth");
+}
+
+int Module::findProgram(string_view name) const {
+    size_t low = 0;
+    size_t high = header->programCount;
+    while (low < high) {
+        size_t middle = (low + high) / 2;
+        if (programName(middle) < name) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low < header->programCount && programName(low) == name ? static_cast<int>(low) : -1;
+}
+
+Bytecode Module::toBytecode(size_t program) const {
+    const ModuleProgram& entry = programs[program];
+    const uint32_t* programVariables = variables + entry.firstVariable;
+    Bytecode bytecode;
+    unordered_map<uint32_t, int> slots;
+    for (uint32_t i = 0; i < entry.variableCount; i++) {
+        slots.emplace(programVariables[i], static_cast<int>(i));
+        bytecode.symbols.emplace_back(symbol(programVariables[i]));
+    }
+    unordered_map<uint32_t, int> localConstants;
+
+    for (uint32_t s = 0; s < entry.statementCount; s++) {
+        const ModuleSequence& sequence = sequences[statements[entry.firstStatement + s]];
+        for (uint32_t pc = 0; pc < sequence.codeLength; pc++) {
+            Instruction instr = code[sequence.codeOffset + pc];
+            if (instr.op == OpCode::Num) {
+                auto it = localConstants.emplace(instr.operand, static_cast<int>(bytecode.constants.size())).first;
+                if (it->second == static_cast<int>(bytecode.constants.size())) bytecode.constants.push_back(constants[instr.operand]);
+                instr.operand = it->second;
+            } else if (instr.op == OpCode::Rval || instr.op == OpCode::Store) {
+                auto it = slots.find(static_cast<uint32_t>(instr.operand));
+                if (it == slots.end()) throw runtime_error("Malformed module: variable outside its program");
+                instr.operand = it->second;
+            }
+            bytecode.code.push_back(instr);
+        }
+        bytecode.statementLines.push_back(static_cast<int>(lines[entry.firstStatement + s]));
+        bytecode.maxStackDepth = max(bytecode.maxStackDepth, static_cast<int>(sequence.maxStackDepth));
+    }
+    return bytecode;
+}
@@ -0,0 +1,264 @@
+#ifndef MODULE_HPP
+#define MODULE_HPP
+
+#include "bytecode.hpp"
+#include "numeric.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// A module links many programs into one file that is used in place through
+// mmap. Symbols and constants are interned across all programs, so an
+// operand means the same thing in every program, and each distinct
+// statement (its expression code and the final STORE) is stored once and
+// shared by every program that contains it. Programs are looked up by name
+// in a sorted index.
+//
+// Layout: a little-endian header, then arrays of the fixed-size records
+// below, each 8-byte aligned and located by its offset from the start of the
+// file, so the file can be mapped at any address:
+//   programs    ModuleProgram, sorted by name
+//   statements  uint32 sequence index of each program statement
+//   lines       uint32 source line of each program statement
+//   variables   uint32 global symbol of each program variable, in slot order
+//   sequences   ModuleSequence, one per distinct statement
+//   code        Instruction, operands are global symbols and constants
+//   constants   uint64
+//   symbols     ModuleString
+//   strings     symbol and program names
+
+struct ModuleString {
+    uint32_t offset;
+    uint32_t length;
+};
+
+struct ModuleProgram {
+    ModuleString name;
+    uint32_t firstStatement;
+    uint32_t statementCount;
+    uint32_t firstVariable;
+    uint32_t variableCount;
+};
+
+struct ModuleSequence {
+    uint32_t codeOffset;
+    uint32_t codeLength;
+    uint32_t maxStackDepth;
+};
+
+struct ModuleHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t programCount;
+    uint32_t statementCount;
+    uint32_t variableCount;
+    uint32_t sequenceCount;
+    uint32_t codeCount;
+    uint32_t constantCount;
+    uint32_t symbolCount;
+    uint32_t stringBytes;
+    uint32_t maxStackDepth;
+    uint32_t reserved;
+    uint64_t programsOffset;
+    uint64_t statementsOffset;
+    uint64_t linesOffset;
+    uint64_t variablesOffset;
+    uint64_t sequencesOffset;
+    uint64_t codeOffset;
+    uint64_t constantsOffset;
+    uint64_t symbolsOffset;
+    uint64_t stringsOffset;
+};
+
+// Collects compiled programs and writes them out as one module. Throws
+// runtime_error when a program name is added twice or its code does not end
+// with a STORE. Statements without a recorded source line get line 0.
+class ModuleLinker {
+public:
+    void add(const string& name, const Bytecode& bytecode);
+    vector<uint8_t> link() const;
+
+    size_t programCount() const { return programs.size(); }
+    size_t statementCount() const { return statements; }
+    size_t sequenceCount() const { return sequences.size(); }
+    size_t symbolCount() const { return symbols.size(); }
+    size_t constantCount() const { return constants.size(); }
+
+private:
+    struct Program {
+        string name;
+        vector<uint32_t> statements;
+        vector<uint32_t> lines;
+        vector<uint32_t> variables;
+    };
+
+    vector<Program> programs;
+    unordered_map<string, size_t> programIndex;
+    vector<string> symbols;
+    unordered_map<string, uint32_t> symbolIndex;
+    vector<uint64_t> constants;
+    unordered_map<uint64_t, uint32_t> constantIndex;
+    vector<Instruction> code;
+    vector<ModuleSequence> sequences;
+    unordered_map<string, uint32_t> sequenceIndex;
+    size_t statements = 0;
+    uint32_t maxStackDepth = 0;
+
+    uint32_t internSymbol(const string& name);
+    uint32_t internConstant(uint64_t value);
+    uint32_t internSequence(const vector<Instruction>& statement);
+};
+
+// A module file mapped read-only. The whole file is validated when it is
+// opened, like deserializeBytecode, so a corrupt module cannot make
+// ModuleExecutor read out of bounds; opening throws runtime_error instead.
+class Module {
+public:
+    explicit Module(const string& path);
+    ~Module();
+    Module(const Module&) = delete;
+    Module& operator=(const Module&) = delete;
+
+    size_t programCount() const { return header->programCount; }
+    size_t symbolCount() const { return header->symbolCount; }
+    size_t variableCount() const { return header->variableCount; }
+    size_t constantCount() const { return header->constantCount; }
+    size_t sequenceCount() const { return header->sequenceCount; }
+    size_t byteSize() const { return size; }
+    int maxStackDepth() const { return static_cast<int>(header->maxStackDepth); }
+
+    // Index of the program with this name, or -1.
+    int findProgram(string_view name) const;
+    string_view programName(size_t program) const { return text(programs[program].name); }
+    string_view symbol(size_t index) const { return text(symbols[index]); }
+    uint64_t constant(size_t index) const { return constants[index]; }
+
+    const ModuleProgram& program(size_t program) const { return programs[program]; }
+    const ModuleSequence& sequence(size_t index) const { return sequences[index]; }
+    const uint32_t* programStatements(size_t program) const { return statements + programs[program].firstStatement; }
+    const uint32_t* programVariables(size_t program) const { return variables + programs[program].firstVariable; }
+    const Instruction* sequenceCode(size_t index) const { return code + sequences[index].codeOffset; }
+
+    // Rebuilds one program as standalone Bytecode with its own slots and
+    // constant pool, for the register VM, the optimizer and the profiler.
+    Bytecode toBytecode(size_t program) const;
+
+private:
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    const ModuleHeader* header = nullptr;
+    const ModuleProgram* programs = nullptr;
+    const uint32_t* statements = nullptr;
+    const uint32_t* lines = nullptr;
+    const uint32_t* variables = nullptr;
+    const ModuleSequence* sequences = nullptr;
+    const Instruction* code = nullptr;
+    const uint64_t* constants = nullptr;
+    const ModuleString* symbols = nullptr;
+    const char* strings = nullptr;
+
+    void validate();
+    string_view text(const ModuleString& string) const { return string_view(strings + string.offset, string.length); }
+};
+
+// Runs programs straight from a mapped module. Every program has its own
+// cells in the frame, one per entry of its variable range, so programs that
+// use the same variable name never share a value and getVariables returns
+// what that program's own last run left. The shared code names variables by
+// global symbol, so a run first binds its program's symbols to its cells;
+// symbols of other programs are bound to a scratch cell. Constants are
+// converted the first time a program that uses them runs, so a literal the
+// backend rejects only fails the programs that contain it.
+template <typename Numeric>
+class ModuleExecutor {
+public:
+    using Value = typename Numeric::Value;
+
+    // The module is referenced, not copied, so it must outlive the
+    // executor; temporaries are rejected.
+    explicit ModuleExecutor(const Module& module);
+    ModuleExecutor(Module&&) = delete;
+    void run(size_t program);
+    vector<Value> getVariables(size_t program) const;
+
+private:
+    const Module& module;
+    vector<Value> constants;
+    vector<bool> constantReady;
+    vector<bool> programReady;
+    vector<uint32_t> cells;
+    vector<Value> frame;
+    vector<Value> stack;
+    uint32_t scratchCell;
+    size_t boundProgram = SIZE_MAX;
+
+    void prepare(size_t program);
+    void bind(size_t program, bool toProgram);
+};
+
+template <typename Numeric>
+ModuleExecutor<Numeric>::ModuleExecutor(const Module& module)
+    : module(module), constants(module.constantCount()), constantReady(module.constantCount()),
+      programReady(module.programCount()), cells(module.symbolCount(), static_cast<uint32_t>(module.variableCount())),
+      frame(module.variableCount() + 1), stack(module.maxStackDepth()),
+      scratchCell(static_cast<uint32_t>(module.variableCount())) {}
+
+template <typename Numeric>
+void ModuleExecutor<Numeric>::prepare(size_t program) {
+    if (programReady[program]) return;
+    const uint32_t* statements = module.programStatements(program);
+    for (uint32_t s = 0; s < module.program(program).statementCount; s++) {
+        const Instruction* code = module.sequenceCode(statements[s]);
+        for (uint32_t pc = 0; pc < module.sequence(statements[s]).codeLength; pc++) {
+            if (code[pc].op == OpCode::Num && !constantReady[code[pc].operand]) {
+                constants[code[pc].operand] = Numeric::fromLiteral(module.constant(code[pc].operand));
+                constantReady[code[pc].operand] = true;
+            }
+        }
+    }
+    programReady[program] = true;
+}
+
+template <typename Numeric>
+void ModuleExecutor<Numeric>::bind(size_t program, bool toProgram) {
+    const ModuleProgram& entry = module.program(program);
+    const uint32_t* variables = module.programVariables(program);
+    for (uint32_t i = 0; i < entry.variableCount; i++) {
+        cells[variables[i]] = toProgram ? entry.firstVariable + i : scratchCell;
+    }
+}
+
+template <typename Numeric>
+void ModuleExecutor<Numeric>::run(size_t program) {
+    prepare(program);
+    if (boundProgram != program) {
+        if (boundProgram != SIZE_MAX) bind(boundProgram, false);
+        bind(program, true);
+        boundProgram = program;
+    }
+    const ModuleProgram& entry = module.program(program);
+    fill(frame.begin() + entry.firstVariable, frame.begin() + entry.firstVariable + entry.variableCount, Value());
+
+    auto slot = [this](int symbol) -> Value& { return frame[cells[symbol]]; };
+
+    const uint32_t* statements = module.programStatements(program);
+    for (uint32_t s = 0; s < entry.statementCount; s++) {
+        const Instruction* instr = module.sequenceCode(statements[s]);
+        const Instruction* end = instr + module.sequence(statements[s]).codeLength;
+        Value* sp = stack.data();
+        for (; instr != end; ++instr) {
+            sp = executeInstruction<Numeric>(*instr, sp, constants.data(), slot);
+        }
+    }
+}
+
+template <typename Numeric>
+vector<typename Numeric::Value> ModuleExecutor<Numeric>::getVariables(size_t program) const {
+    const ModuleProgram& entry = module.program(program);
+    return vector<Value>(frame.begin() + entry.firstVariable, frame.begin() + entry.firstVariable + entry.variableCount);
+}
+
+#endif
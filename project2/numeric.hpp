@@ -0,0 +1,89 @@
+#ifndef NUMERIC_HPP
+#define NUMERIC_HPP
+
+#include <cstdint>
+#include <string>
+#include <stdexcept>
+
+using namespace std;
+
+// Numeric backends for Executor. Each one defines the value type and the
+// arithmetic used by the RPN operations; the executor is instantiated once
+// per backend so the choice never costs anything per instruction.
+
+// Two's complement integers that wrap on overflow. Arithmetic is done in the
+// unsigned type U so that wrapping is well defined.
+template <typename T, typename U>
+struct WrappingNumeric {
+    using Value = T;
+
+    static Value add(Value a, Value b) { return static_cast<Value>(static_cast<U>(a) + static_cast<U>(b)); }
+    static Value sub(Value a, Value b) { return static_cast<Value>(static_cast<U>(a) - static_cast<U>(b)); }
+    static Value mul(Value a, Value b) { return static_cast<Value>(static_cast<U>(a) * static_cast<U>(b)); }
+
+    static Value div(Value a, Value b) {
+        if (b == 0) throw runtime_error("Division by zero");
+        if (b == -1) return sub(0, a);
+        return a / b;
+    }
+
+    static Value fromLiteral(uint64_t literal) { return static_cast<Value>(static_cast<U>(literal)); }
+};
+
+struct Int32Numeric : WrappingNumeric<int32_t, uint32_t> {
+    static constexpr const char* name = "int32";
+};
+
+struct Int64Numeric : WrappingNumeric<int64_t, uint64_t> {
+    static constexpr const char* name = "int64";
+};
+
+struct DoubleNumeric {
+    using Value = double;
+    static constexpr const char* name = "double";
+
+    static Value add(Value a, Value b) { return a + b; }
+    static Value sub(Value a, Value b) { return a - b; }
+    static Value mul(Value a, Value b) { return a * b; }
+    static Value div(Value a, Value b) { return a / b; }
+    static Value fromLiteral(uint64_t literal) { return static_cast<Value>(literal); }
+};
+
+// int64 that raises a runtime_error instead of wrapping.
+struct CheckedInt64Numeric {
+    using Value = int64_t;
+    static constexpr const char* name = "checked";
+
+    static Value add(Value a, Value b) {
+        Value result;
+        if (__builtin_add_overflow(a, b, &result)) throw runtime_error("Integer overflow in PLUS");
+        return result;
+    }
+
+    static Value sub(Value a, Value b) {
+        Value result;
+        if (__builtin_sub_overflow(a, b, &result)) throw runtime_error("Integer overflow in MINUS");
+        return result;
+    }
+
+    static Value mul(Value a, Value b) {
+        Value result;
+        if (__builtin_mul_overflow(a, b, &result)) throw runtime_error("Integer overflow in TIMES");
+        return result;
+    }
+
+    static Value div(Value a, Value b) {
+        if (b == 0) throw runtime_error("Division by zero");
+        if (b == -1 && a == INT64_MIN) throw runtime_error("Integer overflow in DIV");
+        return a / b;
+    }
+
+    static Value fromLiteral(uint64_t literal) {
+        if (literal > static_cast<uint64_t>(INT64_MAX)) {
+            throw runtime_error("Numeric literal out of range: " + to_string(literal));
+        }
+        return static_cast<Value>(literal);
+    }
+};
+
+#endif
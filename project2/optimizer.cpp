@@ -0,0 +1,225 @@
+#include "optimizer.hpp"
+#include <queue>
+#include <stdexcept>
+#include <algorithm>
+
+namespace {
+
+struct Node {
+    OpCode op;
+    int operand;
+    int lhs;
+    int rhs;
+    int height;
+    int need;
+};
+
+struct Term {
+    int node;
+    bool negated;
+};
+
+bool isLeaf(OpCode op) {
+    return op == OpCode::Num || op == OpCode::Rval;
+}
+
+bool isCommutative(OpCode op) {
+    return op == OpCode::Plus || op == OpCode::Times;
+}
+
+class Reassociator {
+public:
+    Reassociator(const Bytecode& bytecode) : bytecode(bytecode) {}
+
+    Bytecode run() {
+        Bytecode result;
+        result.symbols = bytecode.symbols;
+        result.constants = bytecode.constants;
+        result.statementLines = bytecode.statementLines;
+        vector<int> stack;
+
+        for (const Instruction& instr : bytecode.code) {
+            if (isLeaf(instr.op)) {
+                stack.push_back(leaf(instr));
+            } else if (instr.op == OpCode::Store) {
+                int root = optimize(pop(stack));
+                emit(root, result);
+                result.maxStackDepth = max(result.maxStackDepth, nodes[root].need);
+                result.code.push_back(instr);
+                nodes.clear();
+            } else {
+                int rhs = pop(stack);
+                int lhs = pop(stack);
+                stack.push_back(binary(instr.op, lhs, rhs));
+            }
+        }
+        return result;
+    }
+
+private:
+    const Bytecode& bytecode;
+    vector<Node> nodes;
+
+    int pop(vector<int>& stack) {
+        if (stack.empty()) throw runtime_error("Bytecode stack underflow during reassociation");
+        int node = stack.back();
+        stack.pop_back();
+        return node;
+    }
+
+    int leaf(const Instruction& instr) {
+        nodes.push_back({instr.op, instr.operand, -1, -1, 0, 1});
+        return static_cast<int>(nodes.size()) - 1;
+    }
+
+    // need is the Sethi-Ullman number: the stack depth required to evaluate
+    // the node when commutative operands are ordered deepest first.
+    int binary(OpCode op, int lhs, int rhs) {
+        int lhsNeed = nodes[lhs].need;
+        int rhsNeed = nodes[rhs].need;
+        int need;
+        if (isCommutative(op)) {
+            need = lhsNeed == rhsNeed ? lhsNeed + 1 : max(lhsNeed, rhsNeed);
+        } else {
+            need = max(lhsNeed, rhsNeed + 1);
+        }
+        int height = max(nodes[lhs].height, nodes[rhs].height) + 1;
+        nodes.push_back({op, 0, lhs, rhs, height, need});
+        return static_cast<int>(nodes.size()) - 1;
+    }
+
+    // A PLUS/MINUS node inside a PLUS/MINUS chain, or a TIMES node inside
+    // a TIMES chain, is folded into the chain's root and not optimized on
+    // its own.
+    static bool sameChain(OpCode parent, OpCode child) {
+        bool parentSum = parent == OpCode::Plus || parent == OpCode::Minus;
+        bool childSum = child == OpCode::Plus || child == OpCode::Minus;
+        return (parentSum && childSum) || (parent == OpCode::Times && child == OpCode::Times);
+    }
+
+    // The chains are walked with explicit worklists, so a chain of any
+    // length needs no native stack; the operands are already optimized.
+    void collectSum(int root, const vector<int>& optimized, vector<Term>& terms) {
+        vector<Term> worklist = {{root, false}};
+        while (!worklist.empty()) {
+            Term term = worklist.back();
+            worklist.pop_back();
+            const Node& n = nodes[term.node];
+            if (n.op == OpCode::Plus || n.op == OpCode::Minus) {
+                worklist.push_back({n.rhs, n.op == OpCode::Minus ? !term.negated : term.negated});
+                worklist.push_back({n.lhs, term.negated});
+            } else {
+                terms.push_back({optimized[term.node], term.negated});
+            }
+        }
+    }
+
+    void collectProduct(int root, const vector<int>& optimized, vector<int>& factors) {
+        vector<int> worklist = {root};
+        while (!worklist.empty()) {
+            int node = worklist.back();
+            worklist.pop_back();
+            if (nodes[node].op == OpCode::Times) {
+                worklist.push_back(nodes[node].rhs);
+                worklist.push_back(nodes[node].lhs);
+            } else {
+                factors.push_back(optimized[node]);
+            }
+        }
+    }
+
+    // Huffman-style combination: always join the two shallowest subtrees,
+    // which gives the minimum height for the resulting tree.
+    int balance(OpCode op, const vector<int>& operands) {
+        using Entry = pair<int, int>;
+        priority_queue<Entry, vector<Entry>, greater<Entry>> queue;
+        for (int operand : operands) queue.push({nodes[operand].height, operand});
+
+        while (queue.size() > 1) {
+            int lhs = queue.top().second;
+            queue.pop();
+            int rhs = queue.top().second;
+            queue.pop();
+            int combined = binary(op, lhs, rhs);
+            queue.push({nodes[combined].height, combined});
+        }
+        return queue.top().second;
+    }
+
+    // Children always precede their parent in nodes, because the tree is
+    // built from postfix code, so one pass in index order optimizes every
+    // operand before the node that uses it.
+    int optimize(int root) {
+        vector<bool> inChain(root + 1, false);
+        for (int node = 0; node <= root; node++) {
+            const Node& n = nodes[node];
+            if (isLeaf(n.op)) continue;
+            if (sameChain(n.op, nodes[n.lhs].op)) inChain[n.lhs] = true;
+            if (sameChain(n.op, nodes[n.rhs].op)) inChain[n.rhs] = true;
+        }
+
+        vector<int> optimized(root + 1, -1);
+        for (int node = 0; node <= root; node++) {
+            if (!inChain[node]) optimized[node] = optimizeNode(node, optimized);
+        }
+        return optimized[root];
+    }
+
+    int optimizeNode(int node, const vector<int>& optimized) {
+        OpCode op = nodes[node].op;
+        if (isLeaf(op)) return node;
+
+        if (op == OpCode::Plus || op == OpCode::Minus) {
+            vector<Term> terms;
+            collectSum(node, optimized, terms);
+            vector<int> positive;
+            vector<int> negative;
+            for (const Term& term : terms) {
+                (term.negated ? negative : positive).push_back(term.node);
+            }
+            // The leftmost operand of a chain is never negated, so there is
+            // always at least one positive term.
+            int sum = balance(OpCode::Plus, positive);
+            if (negative.empty()) return sum;
+            return binary(OpCode::Minus, sum, balance(OpCode::Plus, negative));
+        }
+
+        if (op == OpCode::Times) {
+            vector<int> factors;
+            collectProduct(node, optimized, factors);
+            return balance(OpCode::Times, factors);
+        }
+
+        return binary(op, optimized[nodes[node].lhs], optimized[nodes[node].rhs]);
+    }
+
+    // Post-order walk with an explicit stack; a node is pushed once to
+    // schedule its operands and once more to emit its own opcode.
+    void emit(int root, Bytecode& result) {
+        vector<pair<int, bool>> worklist = {{root, false}};
+        while (!worklist.empty()) {
+            auto [node, operandsDone] = worklist.back();
+            worklist.pop_back();
+            const Node& n = nodes[node];
+            if (isLeaf(n.op)) {
+                result.code.push_back({n.op, n.operand});
+            } else if (operandsDone) {
+                result.code.push_back({n.op, 0});
+            } else {
+                int first = n.lhs;
+                int second = n.rhs;
+                if (isCommutative(n.op) && nodes[n.rhs].need > nodes[n.lhs].need) swap(first, second);
+                worklist.push_back({node, true});
+                worklist.push_back({second, false});
+                worklist.push_back({first, false});
+            }
+        }
+    }
+};
+
+}
+
+Bytecode reassociate(const Bytecode& bytecode) {
+    Reassociator reassociator(bytecode);
+    return reassociator.run();
+}
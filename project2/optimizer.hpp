@@ -0,0 +1,20 @@
+#ifndef OPTIMIZER_HPP
+#define OPTIMIZER_HPP
+
+#include "bytecode.hpp"
+
+// Tree-height reduction. Each statement's expression is rebuilt so that
+// chains of PLUS/MINUS and of TIMES become balanced trees: a-b+c-d-e turns
+// into (a+c)-(b+(d+e)) and a*b*c*d into (a*b)*(c*d), combining the
+// shallowest subtrees first. Operands of PLUS and TIMES are then ordered so
+// the subtree needing more stack is evaluated first, which keeps the operand
+// stack as shallow as the balanced shape allows.
+//
+// Reassociation is exact only for the wrapping integer backends. For double
+// it can change rounding, and for the checked backend it can report an
+// overflow the source order never reaches (big-1+1 becomes (big+1)-1), so
+// callers must not apply it to those backends. The rewrite needs no native
+// stack, so chains of any length are safe.
+Bytecode reassociate(const Bytecode& bytecode);
+
+#endif
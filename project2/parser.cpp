@@ -1,67 +1,70 @@
 #include "parser.hpp"
 
-Parser::Parser(const vector<Token>& tokens) : tokens(tokens) {}
+Parser::Parser(const vector<Token>& tokens, ParseMode mode, ostream& diagnostics)
+    : tokens(tokens), mode(mode), diagnostics(diagnostics) {}
+
+Parser::Parser(Scanner& scanner, ParseMode mode, ostream& diagnostics)
+    : scanner(&scanner), tokens(streamed), mode(mode), diagnostics(diagnostics) {}
 
 bool Parser::parse() {
     try {
-        program();
+        grammar::Syntax<Parser> syntax(*this);
+        syntax.program();
         return true;
     } catch (const runtime_error& error) {
         return false;
     }
 }
 
-void Parser::program() {
-    consume(TokenType::Begin, "Expected 'begin' at the start of the program.");
-    while (!check(TokenType::End) && !isAtEnd()) {
-        if (match(TokenType::Var)) {
-            declaration();
-        } else {
-            statement();
-        }
-    }
-    consume(TokenType::End, "Expected 'end' after statements.");
-    consume(TokenType::Dot, "Expected '.' after 'end'");
+TokenType Parser::previousType() {
+    return previous().type;
 }
 
-void Parser::declaration() {
-    do {
-        Token varName = consume(TokenType::Identifier, "Expected variable name.");
-        if (declaredVariables.find(varName.value) != declaredVariables.end()) {
-            error(varName, "Illegal redefinition " + varName.value);
-        }
-        declaredVariables.insert(varName.value);
-    } while (match(TokenType::Comma)); 
-    consume(TokenType::Semicolon, "Expected ';' after variable declaration.");
+void Parser::syntaxError(const char* message) {
+    error(peek(), message);
 }
 
-void Parser::statement() {
-    if (check(TokenType::Identifier)) {
-        assignment();
-    } else {
-        error(peek(), "Expected statement.");
-        synchronize();
+void Parser::errorAtPrevious(const char* message) {
+    error(previous(), message);
+}
+
+void Parser::declare() {
+    const Token& varName = previous();
+    if (mode == ParseMode::Full && declaredVariables.find(varName.value) != declaredVariables.end()) {
+        error(varName, "Illegal redefinition " + varName.value);
     }
+    declaredVariables.insert(varName.value);
+}
+
+// Copied: pulling more tokens while parsing the expression may drop it.
+Token Parser::target() {
+    validateIdentifier(previous());
+    return previous();
+}
+
+void Parser::store(const Token& target) {
+    addRPNInstruction("STORE", target.value, target.line);
 }
 
-void Parser::assignment() {
-    Token identifierToken = consume(TokenType::Identifier, "Expected identifier.");
-    validateIdentifier(identifierToken);
-    consume(TokenType::Assign, "Expected '=' after identifier.");
-    expression();
-    addRPNInstruction("STORE", identifierToken.value);
-    consume(TokenType::Semicolon, "Expected ';' after expression.");
+void Parser::number() {
+    addConstant(previous().number);
 }
 
+void Parser::variable() {
+    validateIdentifier(previous());
+    addRPNInstruction("RVAL", previous().value);
+}
+
+void Parser::binary(TokenType op) {
+    addRPNInstruction(grammar::operatorMnemonic(op));
+}
 
 void Parser::validateIdentifier(const Token& token) {
-    if (!token.value.empty() && token.value.back() == '_') {
-        error(token, "Identifier cannot end with an underscore.");
-    }
-    if (token.value.find("__") != std::string::npos) {
-        error(token, "Identifier cannot contain consecutive underscores.");
+    const char* identifierError = grammar::identifierError(token.value);
+    if (identifierError != nullptr) {
+        error(token, identifierError);
     }
-    if (declaredVariables.find(token.value) == declaredVariables.end()) {
+    if (mode == ParseMode::Full && declaredVariables.find(token.value) == declaredVariables.end()) {
         error(token, "Undefined variable " + token.value);
     }
 }
@@ -74,49 +77,32 @@ bool Parser::match(TokenType type) {
     return false;
 }
 
-void Parser::expression() {
-    term(); 
-    while (match(TokenType::Plus) || match(TokenType::Minus)) {
-        std::string op = previous().type == TokenType::Plus ? "PLUS" : "MINUS";
-        term(); 
-        addRPNInstruction(op);
-    }
-}
-
-void Parser::term() {
-    factor(); 
-    while (match(TokenType::Multiply) || match(TokenType::Divide)) {
-        std::string op = previous().type == TokenType::Multiply ? "TIMES" : "DIV";
-        factor(); 
-        addRPNInstruction(op);
-    }
-}
-
-void Parser::factor() {
-    if (match(TokenType::Number)) {
-        addRPNInstruction("NUM", previous().value);
-    } else if (match(TokenType::LeftParen)) {
-        expression();
-        consume(TokenType::RightParen, "Expected ')'.");
-    } else if (match(TokenType::Identifier)) {
-        addRPNInstruction("RVAL", previous().value);
-    }
-}
-
 bool Parser::isAtEnd() {
     return peek().type == TokenType::Eof;
 }
 
-Token Parser::advance() {
+const Token& Parser::advance() {
     if (!isAtEnd()) current++;
     return previous();
 }
 
-Token Parser::peek() {
+// The in-memory token vector always ends with Eof, which is never advanced
+// past, so only a streaming parser can run out. It then drops every token
+// but the previous one before pulling more, which keeps previous() valid.
+const Token& Parser::peek() {
+    if (current == static_cast<int>(tokens.size())) pullTokens();
     return tokens[current];
 }
 
-Token Parser::previous() {
+void Parser::pullTokens() {
+    if (current > 1) {
+        streamed.erase(streamed.begin(), streamed.begin() + (current - 1));
+        current = 1;
+    }
+    scanner->scanMore(streamed);
+}
+
+const Token& Parser::previous() {
     return tokens[current - 1];
 }
 
@@ -125,44 +111,48 @@ bool Parser::check(TokenType type) {
     return peek().type == type;
 }
 
-Token Parser::consume(TokenType type, const string& errorMessage) {
-    if (check(type)) return advance();
-    Token errToken = peek();
-    string fullErrorMessage = errorMessage;
-    error(errToken, fullErrorMessage);
-    throw runtime_error(fullErrorMessage);
-}
-
 void Parser::error(const Token& token, const string& message) {
-    cerr << "Parse error at line " << token.line << ": " << message << endl;
+    diagnostics << "Parse error at line " << token.line << ": " << message << endl;
     throw runtime_error(message);
 }
 
-void Parser::synchronize() {
-    advance();
-    while (!isAtEnd()) {
-        if (previous().type == TokenType::Semicolon) return;
+void Parser::addRPNInstruction(const std::string& operation, const std::string& operand, int line) {
+    if (mode == ParseMode::SyntaxOnly) return;
+    this->rpnInstructions.push_back(RPNInstruction(operation, operand));
+    this->rpnInstructions.back().line = line;
+}
 
-        switch (peek().type) {
-            case TokenType::Begin:
-            case TokenType::End:
-                return;
-            default:
-                advance();
-        }
+// NUM instructions refer to the per-program constant pool, where each
+// distinct value is stored once.
+void Parser::addConstant(uint64_t value) {
+    if (mode == ParseMode::SyntaxOnly) return;
+    auto it = constantIndex.find(value);
+    if (it == constantIndex.end()) {
+        it = constantIndex.emplace(value, static_cast<int>(constants.size())).first;
+        constants.push_back(value);
     }
+    this->rpnInstructions.push_back(RPNInstruction("NUM", it->second));
 }
 
-void Parser::addRPNInstruction(const std::string& operation, const std::string& operand) {
-    this->rpnInstructions.push_back(RPNInstruction(operation, operand));
+const vector<RPNInstruction>& Parser::getRPNInstructions() const {
+    return rpnInstructions;
+}
+
+const vector<uint64_t>& Parser::getConstants() const {
+    return constants;
+}
+
+void Parser::writeRPNInstructions(ostream& out) const {
+    for (const auto& instr : this->rpnInstructions) {
+        string operand = instr.constant >= 0 ? to_string(constants[instr.constant]) : instr.operand;
+        out << "['" << instr.operation << "', '" << (operand.empty() ? "N/A" : operand) << "']\n";
+    }
 }
 
 void Parser::outputRPNInstructions(const std::string& filename) {
     std::ofstream file(filename);
     if (file.is_open()) {
-        for (const auto& instr : this->rpnInstructions) {
-            file << "['" << instr.operation << "', '" << (instr.operand.empty() ? "N/A" : instr.operand) << "']\n";
-        }
+        writeRPNInstructions(file);
         file.close();
     } else {
         std::cerr << "Unable to open file for writing RPN instructions: " << filename << std::endl;
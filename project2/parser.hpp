@@ -5,48 +5,75 @@
 #include <vector>
 #include <string>
 #include <set>
+#include <unordered_map>
+#include <cstdint>
 #include <fstream>
+#include <ostream>
 #include <stdexcept> 
 
 struct RPNInstruction {
     string operation;
     string operand;
+    int constant = -1;
+    int line = 0;
     RPNInstruction(const std::string& op, const std::string& opnd) : operation(op), operand(opnd) {}
+    RPNInstruction(const std::string& op, int constant) : operation(op), constant(constant) {}
+};
+
+// SyntaxOnly checks the grammar and identifier spelling only: declarations
+// are not enforced and no RPN is generated. Project 1 checks its inputs in
+// this mode through compileSource.
+enum class ParseMode {
+    Full, SyntaxOnly
 };
 
 class Parser {
 public:
-    Parser(const vector<Token>& tokens);
+    Parser(const vector<Token>& tokens, ParseMode mode = ParseMode::Full, ostream& diagnostics = cerr);
+    // Pulls tokens from a pull-mode scanner as it goes and drops the ones it
+    // has consumed, so only a block's worth is held at a time.
+    Parser(Scanner& scanner, ParseMode mode = ParseMode::Full, ostream& diagnostics = cerr);
     bool parse();
     void outputRPNInstructions(const std::string& filename);
+    void writeRPNInstructions(ostream& out) const;
+    const vector<RPNInstruction>& getRPNInstructions() const;
+    const vector<uint64_t>& getConstants() const;
 
 private:
+    vector<Token> streamed;
+    Scanner* scanner = nullptr;
     const vector<Token>& tokens;
+    ParseMode mode;
+    ostream& diagnostics;
     int current = 0;
     set<string> declaredVariables;
     vector<RPNInstruction> rpnInstructions; 
+    vector<uint64_t> constants;
+    unordered_map<uint64_t, int> constantIndex;
 
     bool isAtEnd();
-    Token advance();
-    Token peek();
-    Token previous();
+    void pullTokens();
+    const Token& advance();
+    const Token& peek();
+    const Token& previous();
     bool check(TokenType type);
-    Token consume(TokenType type, const string& errorMessage);
-    void synchronize();
-    void validateIdentifier(const Token& token);
     bool match(TokenType type);
+    void validateIdentifier(const Token& token);
 
-    void declaration();
-
-    void program();
-    void statement();
-
-    void expression();
-    void term();
-    void factor();
-    void assignment();
+    // Host interface of grammar::Syntax, which drives the parse.
+    friend class grammar::Syntax<Parser>;
+    TokenType previousType();
+    void syntaxError(const char* message);
+    void errorAtPrevious(const char* message);
+    void declare();
+    Token target();
+    void store(const Token& target);
+    void number();
+    void variable();
+    void binary(TokenType op);
 
-    void addRPNInstruction(const std::string& operation, const std::string& operand = "");
+    void addRPNInstruction(const std::string& operation, const std::string& operand = "", int line = 0);
+    void addConstant(uint64_t value);
 
     void error(const Token& token, const string& message);
 };
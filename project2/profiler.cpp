@@ -0,0 +1,69 @@
+#ifdef ENABLE_PROFILING
+
+#include "profiler.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+ExecutionProfiler::ExecutionProfiler(const Bytecode& bytecode) {
+    size_t count = count_if(bytecode.code.begin(), bytecode.code.end(),
+                            [](const Instruction& instr) { return instr.op == OpCode::Store; });
+    statements.resize(count);
+    for (size_t i = 0; i < count && i < bytecode.statementLines.size(); i++) {
+        statements[i].line = bytecode.statementLines[i];
+    }
+}
+
+// The time stamp counter where there is one, nanoseconds elsewhere.
+uint64_t ExecutionProfiler::readCycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+void ExecutionProfiler::report(ostream& out) const {
+    uint64_t totalCycles = 0;
+    for (const auto& statement : statements) totalCycles += statement.cycles;
+
+    vector<size_t> order(statements.size());
+    for (size_t i = 0; i < order.size(); i++) order[i] = i;
+    stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return statements[a].cycles > statements[b].cycles;
+    });
+
+    out << "Hot statements (stack VM):" << endl;
+    for (size_t index : order) {
+        const StatementProfile& statement = statements[index];
+        double share = totalCycles == 0 ? 0.0 : 100.0 * statement.cycles / totalCycles;
+        out << "  line " << statement.line << " (statement " << index + 1 << "): "
+            << statement.cycles << " cycles (" << fixed << setprecision(1) << share << "%), "
+            << statement.executions << " executions, " << statement.instructions << " instructions, "
+            << "max stack depth " << statement.maxStackDepth << endl;
+    }
+    out.unsetf(ios::floatfield);
+
+    out << "Opcode counts:" << endl;
+    for (int op = 0; op < opcodeCount; op++) {
+        if (opcodeCounts[op] > 0) {
+            out << "  " << opCodeToString(static_cast<OpCode>(op)) << ": " << opcodeCounts[op] << endl;
+        }
+    }
+}
+
+// One "program;line N" frame per statement weighted by its cycles, the
+// folded format read by flamegraph.pl and speedscope.
+void ExecutionProfiler::writeFoldedStacks(ostream& out, const string& programName) const {
+    for (const auto& statement : statements) {
+        if (statement.cycles > 0) {
+            out << programName << ";line " << statement.line << " " << statement.cycles << "\n";
+        }
+    }
+}
+
+#endif
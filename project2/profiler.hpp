@@ -0,0 +1,72 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include "bytecode.hpp"
+#include <cstddef>
+
+// Profiler policy used by release builds: every hook is empty, so the
+// instrumentation in Executor compiles away.
+struct NoProfiler {
+    void runStart() {}
+    void instruction(OpCode, size_t) {}
+};
+
+#ifdef ENABLE_PROFILING
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Counts executed opcodes and, per statement, executions, instructions and
+// the deepest operand stack. Cycles are sampled once per statement (at each
+// STORE) rather than per instruction to keep the overhead low. A statement
+// is attributed to the line of its STORE target.
+class ExecutionProfiler {
+public:
+    ExecutionProfiler(const Bytecode& bytecode);
+
+    void runStart() {
+        current = 0;
+        statementStart = readCycles();
+    }
+
+    void instruction(OpCode op, size_t depth) {
+        opcodeCounts[static_cast<int>(op)]++;
+        StatementProfile& statement = statements[current];
+        statement.instructions++;
+        if (depth > statement.maxStackDepth) statement.maxStackDepth = depth;
+        if (op == OpCode::Store) {
+            uint64_t now = readCycles();
+            statement.cycles += now - statementStart;
+            statement.executions++;
+            statementStart = now;
+            current++;
+        }
+    }
+
+    void report(ostream& out) const;
+    void writeFoldedStacks(ostream& out, const string& programName) const;
+
+private:
+    struct StatementProfile {
+        int line = 0;
+        uint64_t executions = 0;
+        uint64_t instructions = 0;
+        uint64_t cycles = 0;
+        size_t maxStackDepth = 0;
+    };
+
+    static const int opcodeCount = static_cast<int>(OpCode::Div) + 1;
+
+    vector<StatementProfile> statements;
+    uint64_t opcodeCounts[opcodeCount] = {};
+    size_t current = 0;
+    uint64_t statementStart = 0;
+
+    static uint64_t readCycles();
+};
+
+#endif
+
+#endif
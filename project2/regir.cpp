@@ -0,0 +1,216 @@
+#include "regir.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+enum class OperandKind { VirtualRegister, Variable, Constant };
+
+struct Operand {
+    OperandKind kind;
+    int index;
+};
+
+struct VirtualInstruction {
+    RegOp op;
+    Operand dest;
+    Operand lhs;
+    Operand rhs;
+};
+
+struct Interval {
+    int vreg = 0;
+    int start = -1;
+    int end = -1;
+};
+
+// Where each virtual register lives after allocation.
+struct Location {
+    bool spilled = false;
+    int index = 0;
+};
+
+RegOp binaryOp(OpCode op) {
+    switch (op) {
+        case OpCode::Plus: return RegOp::Plus;
+        case OpCode::Minus: return RegOp::Minus;
+        case OpCode::Times: return RegOp::Times;
+        case OpCode::Div: return RegOp::Div;
+        default: throw runtime_error("Not a binary operation: " + opCodeToString(op));
+    }
+}
+
+Operand pop(vector<Operand>& stack) {
+    if (stack.empty()) throw runtime_error("Bytecode stack underflow during register lowering");
+    Operand operand = stack.back();
+    stack.pop_back();
+    return operand;
+}
+
+// Simulates the operand stack: NUM and RVAL produce no code, each operator
+// defines a fresh virtual register, and STORE writes straight into the
+// variable when the value was computed by the instruction just before it.
+vector<VirtualInstruction> lowerToVirtual(const Bytecode& bytecode, int& vregCount) {
+    vector<VirtualInstruction> code;
+    vector<Operand> stack;
+    vregCount = 0;
+
+    for (const Instruction& instr : bytecode.code) {
+        switch (instr.op) {
+            case OpCode::Num:
+                stack.push_back({OperandKind::Constant, instr.operand});
+                break;
+            case OpCode::Rval:
+                stack.push_back({OperandKind::Variable, instr.operand});
+                break;
+            case OpCode::Store: {
+                Operand value = pop(stack);
+                Operand target = {OperandKind::Variable, instr.operand};
+                if (value.kind == OperandKind::VirtualRegister && !code.empty() &&
+                    code.back().dest.kind == OperandKind::VirtualRegister && code.back().dest.index == value.index) {
+                    code.back().dest = target;
+                } else {
+                    code.push_back({RegOp::Move, target, value, value});
+                }
+                break;
+            }
+            default: {
+                Operand rhs = pop(stack);
+                Operand lhs = pop(stack);
+                Operand dest = {OperandKind::VirtualRegister, vregCount++};
+                code.push_back({binaryOp(instr.op), dest, lhs, rhs});
+                stack.push_back(dest);
+                break;
+            }
+        }
+    }
+    return code;
+}
+
+vector<Interval> liveIntervals(const vector<VirtualInstruction>& code, int vregCount) {
+    vector<Interval> intervals(vregCount);
+    auto use = [&](const Operand& operand, int position) {
+        if (operand.kind == OperandKind::VirtualRegister) intervals[operand.index].end = position;
+    };
+
+    for (int i = 0; i < static_cast<int>(code.size()); i++) {
+        use(code[i].lhs, i);
+        use(code[i].rhs, i);
+        if (code[i].dest.kind == OperandKind::VirtualRegister) {
+            intervals[code[i].dest.index] = {code[i].dest.index, i, i};
+        }
+    }
+    // Virtual registers are defined in instruction order, so the intervals
+    // are already sorted by start point. Registers whose defining instruction
+    // was retargeted to a variable by STORE have no interval at all.
+    vector<Interval> live;
+    for (const auto& interval : intervals) {
+        if (interval.start >= 0) live.push_back(interval);
+    }
+    return live;
+}
+
+// Linear scan (Poletto and Sarkar). An interval may take over a register
+// released at its own start point, because the VM reads both operands before
+// writing the destination.
+vector<Location> linearScan(const vector<Interval>& intervals, int vregCount, int registerCount, int& spillSlots) {
+    vector<Location> locations(vregCount);
+    vector<Interval> active;
+    vector<Interval> spilledActive;
+    vector<int> freeRegisters;
+    vector<int> freeSpillSlots;
+    spillSlots = 0;
+
+    for (int r = registerCount - 1; r >= 0; r--) freeRegisters.push_back(r);
+
+    auto byEnd = [](const Interval& a, const Interval& b) { return a.end < b.end; };
+
+    for (const Interval& interval : intervals) {
+        while (!active.empty() && active.front().end <= interval.start) {
+            freeRegisters.push_back(locations[active.front().vreg].index);
+            active.erase(active.begin());
+        }
+        for (auto it = spilledActive.begin(); it != spilledActive.end();) {
+            if (it->end <= interval.start) {
+                freeSpillSlots.push_back(locations[it->vreg].index);
+                it = spilledActive.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        auto newSpillSlot = [&]() {
+            if (freeSpillSlots.empty()) return spillSlots++;
+            int slot = freeSpillSlots.back();
+            freeSpillSlots.pop_back();
+            return slot;
+        };
+
+        Interval current = interval;
+        if (freeRegisters.empty()) {
+            Interval& furthest = active.back();
+            if (furthest.end > current.end) {
+                locations[current.vreg] = locations[furthest.vreg];
+                locations[furthest.vreg] = {true, newSpillSlot()};
+                spilledActive.push_back(furthest);
+                active.pop_back();
+            } else {
+                locations[current.vreg] = {true, newSpillSlot()};
+                spilledActive.push_back(current);
+                continue;
+            }
+        } else {
+            locations[current.vreg] = {false, freeRegisters.back()};
+            freeRegisters.pop_back();
+        }
+        active.insert(upper_bound(active.begin(), active.end(), current, byEnd), current);
+    }
+    return locations;
+}
+
+}
+
+string regOpToString(RegOp op) {
+    switch (op) {
+        case RegOp::Move: return "MOVE";
+        case RegOp::Plus: return "PLUS";
+        case RegOp::Minus: return "MINUS";
+        case RegOp::Times: return "TIMES";
+        case RegOp::Div: return "DIV";
+    }
+    return "NotImplemented";
+}
+
+RegisterProgram lowerToRegisters(const Bytecode& bytecode, int registerCount) {
+    if (registerCount < 1) throw runtime_error("The register file needs at least one register");
+
+    int vregCount = 0;
+    vector<VirtualInstruction> virtualCode = lowerToVirtual(bytecode, vregCount);
+    vector<Interval> intervals = liveIntervals(virtualCode, vregCount);
+
+    RegisterProgram program;
+    program.symbols = bytecode.symbols;
+    program.constants = bytecode.constants;
+    program.registerCount = registerCount;
+    vector<Location> locations = linearScan(intervals, vregCount, registerCount, program.spillSlots);
+
+    auto cell = [&](const Operand& operand) {
+        switch (operand.kind) {
+            case OperandKind::VirtualRegister: {
+                const Location& location = locations[operand.index];
+                return location.spilled ? program.registerCount + location.index : location.index;
+            }
+            case OperandKind::Variable:
+                return program.variableBase() + operand.index;
+            case OperandKind::Constant:
+                return program.constantBase() + operand.index;
+        }
+        return 0;
+    };
+
+    program.code.reserve(virtualCode.size());
+    for (const auto& instr : virtualCode) {
+        program.code.push_back({instr.op, cell(instr.dest), cell(instr.lhs), cell(instr.rhs)});
+    }
+    return program;
+}
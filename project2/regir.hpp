@@ -0,0 +1,41 @@
+#ifndef REGIR_HPP
+#define REGIR_HPP
+
+#include "bytecode.hpp"
+#include <vector>
+#include <string>
+
+enum class RegOp {
+    Move, Plus, Minus, Times, Div
+};
+
+// Three-address instruction. Operands are cell indices into the register
+// VM's frame, so a register, a spill slot, a variable and a constant are all
+// read the same way and only the opcode needs dispatching.
+struct RegInstruction {
+    RegOp op;
+    int dest;
+    int lhs;
+    int rhs;
+};
+
+// Frame layout: [registers][spill slots][variables][constants].
+struct RegisterProgram {
+    vector<RegInstruction> code;
+    vector<string> symbols;
+    vector<uint64_t> constants;
+    int registerCount = 0;
+    int spillSlots = 0;
+
+    int variableBase() const { return registerCount + spillSlots; }
+    int constantBase() const { return variableBase() + static_cast<int>(symbols.size()); }
+    int frameSize() const { return constantBase() + static_cast<int>(constants.size()); }
+};
+
+// Lowers stack bytecode to virtual-register three-address code and maps the
+// virtual registers onto registerCount physical registers by linear scan,
+// spilling the interval that ends last when they run out.
+RegisterProgram lowerToRegisters(const Bytecode& bytecode, int registerCount = 8);
+string regOpToString(RegOp op);
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef REGVM_HPP
+#define REGVM_HPP
+
+#include "regir.hpp"
+#include "numeric.hpp"
+#include <vector>
+#include <algorithm>
+
+// Interpreter for RegisterProgram, specialized on a backend from
+// numeric.hpp like Executor. All variables start at zero.
+template <typename Numeric>
+class RegisterVM {
+public:
+    using Value = typename Numeric::Value;
+
+    // The program is referenced, not copied, so it must outlive the VM;
+    // temporaries are rejected.
+    RegisterVM(const RegisterProgram& program);
+    RegisterVM(RegisterProgram&&) = delete;
+    void run();
+    vector<Value> getVariables() const;
+
+private:
+    const RegisterProgram& program;
+    vector<Value> frame;
+};
+
+template <typename Numeric>
+RegisterVM<Numeric>::RegisterVM(const RegisterProgram& program) : program(program), frame(program.frameSize()) {
+    for (size_t i = 0; i < program.constants.size(); i++) {
+        frame[program.constantBase() + i] = Numeric::fromLiteral(program.constants[i]);
+    }
+}
+
+template <typename Numeric>
+void RegisterVM<Numeric>::run() {
+    fill(frame.begin(), frame.begin() + program.constantBase(), Value());
+    Value* cells = frame.data();
+
+    for (const RegInstruction& instr : program.code) {
+        switch (instr.op) {
+            case RegOp::Move: cells[instr.dest] = cells[instr.lhs]; break;
+            case RegOp::Plus: cells[instr.dest] = Numeric::add(cells[instr.lhs], cells[instr.rhs]); break;
+            case RegOp::Minus: cells[instr.dest] = Numeric::sub(cells[instr.lhs], cells[instr.rhs]); break;
+            case RegOp::Times: cells[instr.dest] = Numeric::mul(cells[instr.lhs], cells[instr.rhs]); break;
+            case RegOp::Div: cells[instr.dest] = Numeric::div(cells[instr.lhs], cells[instr.rhs]); break;
+        }
+    }
+}
+
+template <typename Numeric>
+vector<typename Numeric::Value> RegisterVM<Numeric>::getVariables() const {
+    auto begin = frame.begin() + program.variableBase();
+    return vector<Value>(begin, begin + program.symbols.size());
+}
+
+#endif
@@ -1,6 +1,52 @@
 #include "scanner.hpp"
+#include <algorithm>
+#include <cstring>
 
-Scanner::Scanner(const string& source) : source(source) {}
+// Decodes eight ASCII digits at once (SWAR): adjacent digits are merged into
+// 2-digit, then 4-digit, then 8-digit lanes with one multiply-add each.
+static uint64_t decodeEightDigits(const char* digits) {
+    uint64_t chunk;
+    memcpy(&chunk, digits, sizeof(chunk));
+    chunk -= 0x3030303030303030ULL;
+    chunk = (chunk * 10 + (chunk >> 8)) & 0x00FF00FF00FF00FFULL;
+    chunk = (chunk * 100 + (chunk >> 16)) & 0x0000FFFF0000FFFFULL;
+    chunk = (chunk * 10000 + (chunk >> 32)) & 0x00000000FFFFFFFFULL;
+    return chunk;
+}
+
+static bool decodeNumber(const char* digits, size_t length, uint64_t& value) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    if (length > grammar::maxNumberDigits) return false;
+    uint64_t result = 0;
+    while (length >= 8) {
+        if (__builtin_mul_overflow(result, 100000000ULL, &result) ||
+            __builtin_add_overflow(result, decodeEightDigits(digits), &result)) {
+            return false;
+        }
+        digits += 8;
+        length -= 8;
+    }
+    uint64_t tail;
+    if (!grammar::decodeNumber(string_view(digits, length), tail)) return false;
+    uint64_t scale = 1;
+    for (size_t i = 0; i < length; i++) scale *= 10;
+    if (__builtin_mul_overflow(result, scale, &result) || __builtin_add_overflow(result, tail, &result)) {
+        return false;
+    }
+    value = result;
+    return true;
+#else
+    return grammar::decodeNumber(string_view(digits, length), value);
+#endif
+}
+
+// source is not copied; it must outlive the Scanner.
+Scanner::Scanner(string_view source, ostream& diagnostics) : source(source), diagnostics(diagnostics) {}
+
+Scanner::Scanner(ostream& diagnostics) : diagnostics(diagnostics), endOfInput(false) {}
+
+Scanner::Scanner(BlockSource blocks, ostream& diagnostics)
+    : diagnostics(diagnostics), endOfInput(false), blocks(std::move(blocks)) {}
 
 bool Scanner::isAtEnd() {
     return current >= source.length();
@@ -36,8 +82,7 @@ void Scanner::addToken(TokenType type, string value) {
     if (value.empty()) {
         value = "N/A";
     }
-    Token token = {type, value, line};
-    tokens.push_back(token);
+    tokens.push_back({type, std::move(value), line});
 }
 
 
@@ -66,33 +111,32 @@ char Scanner::peekNext() {
 
 void Scanner::scanToken() {
     char c = advance();
-    switch (c) {
-        case '(': addToken(TokenType::LeftParen); break;
-        case ')': addToken(TokenType::RightParen); break;
-        case ';': addToken(TokenType::Semicolon); break;
-        case '.': addToken(TokenType::Dot); break;
-        case '=': addToken(TokenType::Assign); break;
-        case '+': addToken(TokenType::Plus); break;
-        case '-': addToken(TokenType::Minus); break;
-        case '*': addToken(TokenType::Multiply); break;
-        case '/': addToken(TokenType::Divide); break;
-        case ',': addToken(TokenType::Comma); break;
-        case '~': comment(); break;
-        default:
-            if (isDigit(c)) {
-                number();
-            } else if (isAlpha(c)) {
-                identifier();
-            } else {
-                cerr << "Unexpected character: '" << c << "' at line " << line << endl; 
-            }
-            break;
+    TokenType type = grammar::punctuation(c);
+    if (type != TokenType::Unknown) {
+        addToken(type);
+    } else if (c == grammar::commentStart) {
+        comment();
+    } else if (isDigit(c)) {
+        number();
+    } else if (isAlpha(c)) {
+        identifier();
+    } else {
+        diagnostics << "Unexpected character: '" << c << "' at line " << line << endl; 
     }
 }
 
 void Scanner::number() {
     while (isDigit(peek())) advance();
-    addToken(TokenType::Number, source.substr(start, current - start));
+    if (reachedEndOfChunk(Pending::Number)) return;
+    string_view digits = lexeme(Pending::Number);
+    uint64_t value;
+    if (!decodeNumber(digits.data(), digits.size(), value)) {
+        diagnostics << "Numeric literal out of range at line " << line << endl;
+        addToken(TokenType::Unknown);
+    } else {
+        tokens.push_back({TokenType::Number, "", line, value});
+    }
+    partial.clear();
 }
 
 
@@ -100,13 +144,11 @@ void Scanner::identifier() {
     while (isAlphaNumeric(peek()) || peek() == '_') {
         advance();
     }
-    string text = source.substr(start, current - start);
-
-    TokenType type = TokenType::Identifier;
-    if (text == "begin") type = TokenType::Begin;
-    else if (text == "end") type = TokenType::End;
-    else if (text == "var") type = TokenType::Var;
-    addToken(type, text);
+    if (reachedEndOfChunk(Pending::Identifier)) return;
+    string text(lexeme(Pending::Identifier));
+    partial.clear();
+    TokenType type = grammar::keyword(text);
+    addToken(type, std::move(text));
 }
 
 
@@ -114,6 +156,7 @@ void Scanner::identifier() {
 
 void Scanner::comment() {
     while (peek() != '\n' && !isAtEnd()) advance();
+    reachedEndOfChunk(Pending::Comment);
 }
 
 void Scanner::skipWhitespace() {
@@ -136,24 +179,98 @@ void Scanner::skipWhitespace() {
 }
 
 bool Scanner::isAlpha(char c) {
-    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+    return grammar::isAlpha(c);
 }
 
 bool Scanner::isAlphaNumeric(char c) {
-    return isAlpha(c) || isDigit(c);
+    return grammar::isAlphaNumeric(c);
 }
 
 bool Scanner::isDigit(char c) {
-    return c >= '0' && c <= '9';
+    return grammar::isDigit(c);
 }
 
-vector<Token> Scanner::scanTokens() {
-    while (!isAtEnd()) {
+// A token that runs into the end of a chunk may continue in the next one;
+// what it needs of this chunk is kept in partial.
+bool Scanner::reachedEndOfChunk(Pending kind) {
+    if (!isAtEnd() || endOfInput) return false;
+    keepPartial(kind);
+    pending = kind;
+    return true;
+}
+
+// Digits past maxNumberDigits cannot change the verdict that the literal is
+// out of range, so they are not kept.
+void Scanner::keepPartial(Pending kind) {
+    string_view text = source.substr(start, current - start);
+    if (kind == Pending::Identifier) {
+        partial.append(text);
+    } else if (kind == Pending::Number) {
+        partial.append(text.substr(0, grammar::maxNumberDigits + 1 - min(partial.size(), grammar::maxNumberDigits + 1)));
+    }
+}
+
+// The finished token's text, including any part carried over from earlier
+// chunks.
+string_view Scanner::lexeme(Pending kind) {
+    if (partial.empty()) return source.substr(start, current - start);
+    keepPartial(kind);
+    return partial;
+}
+
+void Scanner::scanAvailable() {
+    if (pending != Pending::None) {
+        Pending resumed = pending;
+        pending = Pending::None;
         start = current;
+        switch (resumed) {
+            case Pending::Comment: comment(); break;
+            case Pending::Number: number(); break;
+            case Pending::Identifier: identifier(); break;
+            case Pending::None: break;
+        }
+        if (pending != Pending::None) return;
+    }
+    while (true) {
+        if (!firstToken) skipWhitespace();
+        if (isAtEnd()) break;
+        start = current;
+        firstToken = false;
         scanToken();
-        skipWhitespace();
+        if (pending != Pending::None) break;
     }
+}
 
+vector<Token> Scanner::scanTokens() {
+    scanAvailable();
     tokens.push_back({TokenType::Eof, "N/A", line});
-    return tokens;
-}
\ No newline at end of file
+    return std::move(tokens);
+}
+
+void Scanner::feed(string_view chunk) {
+    source = chunk;
+    start = current = 0;
+    scanAvailable();
+}
+
+vector<Token> Scanner::finish() {
+    endOfInput = true;
+    feed("");
+    return scanTokens();
+}
+
+bool Scanner::scanMore(vector<Token>& out) {
+    if (endOfInput && tokens.empty()) return false;
+    while (tokens.empty()) {
+        if (blocks(block)) {
+            feed(block);
+        } else {
+            endOfInput = true;
+            feed("");
+            tokens.push_back({TokenType::Eof, "N/A", line});
+        }
+    }
+    out.insert(out.end(), make_move_iterator(tokens.begin()), make_move_iterator(tokens.end()));
+    tokens.clear();
+    return true;
+}
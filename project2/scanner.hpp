@@ -3,34 +3,73 @@
 
 #include <vector>
 #include <string>
+#include <string_view>
 #include <cctype>
 #include <iostream>
+#include <cstdint>
+#include <functional>
+#include "grammar.hpp"
 
 using namespace std;
 
-enum class TokenType {
-    Begin, End, Identifier, Number, Assign, Semicolon, Plus, Minus, Multiply, Divide, LeftParen, RightParen, Dot, Comment, Unknown, Eof, Var, Comma
-};
-
 struct Token {
     TokenType type;
     string value;
     int line;
+    uint64_t number = 0;
 };
 
 class Scanner {
 public:
-    Scanner(const string& source);
+    // The tokens are moved out, so scanTokens() and finish() may only be
+    // called once. The source is referenced, not copied, so it must outlive
+    // the Scanner; temporary strings are rejected.
+    Scanner(string_view source, ostream& diagnostics = cerr);
+    Scanner(string&&, ostream& = cerr) = delete;
     vector<Token> scanTokens();
     string tokenTypeToString(TokenType type);
 
+    // Streaming use: feed the source in consecutive chunks, then call
+    // finish(). A number, identifier or comment cut off at the end of a
+    // chunk is continued by the next one without rescanning: comments keep
+    // nothing, numbers keep only the digits that can still fit in 64 bits,
+    // and identifiers keep their text. The chunk itself is not retained.
+    Scanner(ostream& diagnostics = cerr);
+    void feed(string_view chunk);
+    vector<Token> finish();
+
+    // Pull use: a block is requested from blocks only when more tokens are
+    // needed. scanMore() moves at least one token onto the end of out, the
+    // last one being Eof, and returns false without adding any once Eof has
+    // been handed out. With Parser(Scanner&) neither the input nor all of
+    // its tokens are ever held at once.
+    using BlockSource = function<bool(string& block)>;
+    Scanner(BlockSource blocks, ostream& diagnostics = cerr);
+    bool scanMore(vector<Token>& out);
+
 private:
-    string source;
+    // A token left unfinished at the end of the previous chunk.
+    enum class Pending {
+        None, Comment, Number, Identifier
+    };
+
+    string_view source;
+    ostream& diagnostics;
     vector<Token> tokens;
     unsigned int start = 0;
     unsigned int current = 0;
     int line = 1;
+    bool endOfInput = true;
+    bool firstToken = true;
+    Pending pending = Pending::None;
+    string partial;
+    BlockSource blocks;
+    string block;
 
+    void scanAvailable();
+    bool reachedEndOfChunk(Pending kind);
+    void keepPartial(Pending kind);
+    string_view lexeme(Pending kind);
     void scanToken();
     bool isAtEnd();
     void addToken(TokenType type);
@@ -0,0 +1,162 @@
+#include "snapshot.hpp"
+#include "mappedfile.hpp"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+const uint32_t snapshotVersion = 1;
+
+// FNV-1a on 64-bit words, with an extra shift so that high bits reach the
+// low ones.
+class Hasher {
+public:
+    uint64_t hash = 14695981039346656037ULL;
+
+    void word(uint64_t value) {
+        hash = (hash ^ value) * 1099511628211ULL;
+        hash ^= hash >> 29;
+    }
+
+    void text(const string& value) {
+        word(value.size());
+        size_t i = 0;
+        for (; i + 8 <= value.size(); i += 8) {
+            uint64_t chunk;
+            memcpy(&chunk, value.data() + i, sizeof(chunk));
+            word(chunk);
+        }
+        uint64_t tail = 0;
+        memcpy(&tail, value.data() + i, value.size() - i);
+        word(tail);
+    }
+};
+
+}
+
+uint64_t bytecodeChecksum(const Bytecode& bytecode) {
+    Hasher hasher;
+    hasher.word(static_cast<uint64_t>(bytecode.maxStackDepth));
+    hasher.word(bytecode.code.size());
+    for (const auto& instr : bytecode.code) {
+        hasher.word(static_cast<uint64_t>(instr.op) << 32 | static_cast<uint32_t>(instr.operand));
+    }
+    hasher.word(bytecode.symbols.size());
+    for (const auto& symbol : bytecode.symbols) hasher.text(symbol);
+    hasher.word(bytecode.constants.size());
+    for (uint64_t constant : bytecode.constants) hasher.word(constant);
+    hasher.word(bytecode.statementLines.size());
+    for (int line : bytecode.statementLines) hasher.word(static_cast<uint32_t>(line));
+    return hasher.hash;
+}
+
+void writeSnapshot(const string& path, const Bytecode& bytecode, const char* numericName,
+                   const void* slots, size_t valueSize, uint64_t pc, uint64_t statement) {
+    requireLittleEndian("Snapshots");
+    string strings;
+    vector<SnapshotSymbol> symbols;
+    for (const auto& symbol : bytecode.symbols) {
+        symbols.push_back({static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(symbol.size())});
+        strings += symbol;
+    }
+
+    SnapshotHeader header = {};
+    memcpy(header.magic, "RPNS", 4);
+    header.version = snapshotVersion;
+    strncpy(header.numeric, numericName, sizeof(header.numeric) - 1);
+    header.bytecodeChecksum = bytecodeChecksum(bytecode);
+    header.pc = pc;
+    header.statement = statement;
+    header.slotCount = static_cast<uint32_t>(bytecode.symbols.size());
+    header.valueSize = static_cast<uint32_t>(valueSize);
+    header.stringBytes = static_cast<uint32_t>(strings.size());
+
+    string bytes(sizeof(SnapshotHeader), '\0');
+    header.slotsOffset = appendSection(bytes, slots, bytecode.symbols.size() * valueSize);
+    header.symbolsOffset = appendSection(bytes, symbols.data(), symbols.size() * sizeof(SnapshotSymbol));
+    header.stringsOffset = appendSection(bytes, strings.data(), strings.size());
+    memcpy(&bytes[0], &header, sizeof(header));
+
+    string temporaryPath = path + ".tmp";
+    FILE* file = fopen(temporaryPath.c_str(), "wb");
+    if (file == nullptr) throw runtime_error("Could not write snapshot: " + path);
+    bool written = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    written = fclose(file) == 0 && written;
+    if (!written || rename(temporaryPath.c_str(), path.c_str()) != 0) {
+        remove(temporaryPath.c_str());
+        throw runtime_error("Could not write snapshot: " + path);
+    }
+}
+
+Snapshot::Snapshot(const string& path, const Bytecode& bytecode, const char* numericName, size_t valueSize) {
+    requireLittleEndian("Snapshots");
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw runtime_error("Could not open snapshot: " + path);
+    struct stat status;
+    if (fstat(fd, &status) != 0 || status.st_size < static_cast<off_t>(sizeof(SnapshotHeader))) {
+        close(fd);
+        throw runtime_error("Malformed snapshot: truncated");
+    }
+    size = static_cast<size_t>(status.st_size);
+    void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) throw runtime_error("Could not map snapshot: " + path);
+    data = static_cast<uint8_t*>(mapping);
+
+    try {
+        validate(bytecode, numericName, valueSize);
+    } catch (...) {
+        munmap(data, size);
+        throw;
+    }
+}
+
+Snapshot::~Snapshot() {
+    munmap(data, size);
+}
+
+void Snapshot::validate(const Bytecode& bytecode, const char* numericName, size_t valueSize) {
+    header = reinterpret_cast<const SnapshotHeader*>(data);
+    if (memcmp(header->magic, "RPNS", 4) != 0) throw runtime_error("Malformed snapshot: bad magic");
+    if (header->version != snapshotVersion) throw runtime_error("Unsupported snapshot version");
+    if (strncmp(header->numeric, numericName, sizeof(header->numeric)) != 0 || header->valueSize != valueSize) {
+        throw runtime_error("Snapshot was taken with " + string(header->numeric, strnlen(header->numeric, sizeof(header->numeric))) +
+                            " values, not " + numericName);
+    }
+    if (header->bytecodeChecksum != bytecodeChecksum(bytecode) || header->slotCount != bytecode.symbols.size()) {
+        throw runtime_error("Stale snapshot: the program has changed since it was taken");
+    }
+
+    auto checkSection = [&](uint64_t offset, uint64_t bytes) {
+        if (offset % 8 != 0 || offset > size || bytes > size - offset) {
+            throw runtime_error("Malformed snapshot: section out of bounds");
+        }
+    };
+    checkSection(header->slotsOffset, uint64_t(header->slotCount) * valueSize);
+    checkSection(header->symbolsOffset, uint64_t(header->slotCount) * sizeof(SnapshotSymbol));
+    checkSection(header->stringsOffset, header->stringBytes);
+
+    const SnapshotSymbol* symbols = reinterpret_cast<const SnapshotSymbol*>(data + header->symbolsOffset);
+    const char* strings = reinterpret_cast<const char*>(data + header->stringsOffset);
+    for (uint32_t slot = 0; slot < header->slotCount; slot++) {
+        if (uint64_t(symbols[slot].offset) + symbols[slot].length > header->stringBytes ||
+            string_view(strings + symbols[slot].offset, symbols[slot].length) != bytecode.symbols[slot]) {
+            throw runtime_error("Malformed snapshot: symbol map does not match the program");
+        }
+    }
+
+    // The saved position must be the start of the statement it claims to be.
+    if (header->pc > bytecode.code.size()) throw runtime_error("Malformed snapshot: bad position");
+    uint64_t statements = 0;
+    for (uint64_t pc = 0; pc < header->pc; pc++) {
+        if (bytecode.code[pc].op == OpCode::Store) statements++;
+    }
+    if ((header->pc > 0 && bytecode.code[header->pc - 1].op != OpCode::Store) || statements != header->statement) {
+        throw runtime_error("Malformed snapshot: bad position");
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef SNAPSHOT_HPP
+#define SNAPSHOT_HPP
+
+#include "bytecode.hpp"
+#include <cstdint>
+#include <string>
+
+// Executor state between two statements: the variable slots, the
+// symbol-to-slot map and the position of the next statement. The stack is
+// always empty there, so nothing else is needed to continue.
+//
+// Layout: a little-endian header, then sections located by their offset
+// from the start of the file, so the file can be mapped at any address:
+//   slots    one Value per variable, 8-byte aligned
+//   symbols  SnapshotSymbol per slot, in slot order
+//   strings  symbol names
+// The header records the numeric backend and a checksum of the serialized
+// bytecode, so a snapshot is only ever resumed by the program it came from.
+
+struct SnapshotSymbol {
+    uint32_t offset;
+    uint32_t length;
+};
+
+struct SnapshotHeader {
+    char magic[4];
+    uint32_t version;
+    char numeric[16];
+    uint64_t bytecodeChecksum;
+    uint64_t pc;
+    uint64_t statement;
+    uint32_t slotCount;
+    uint32_t valueSize;
+    uint32_t stringBytes;
+    uint32_t reserved;
+    uint64_t slotsOffset;
+    uint64_t symbolsOffset;
+    uint64_t stringsOffset;
+};
+
+// Hash of everything serializeBytecode writes, computed a word at a time
+// without serializing.
+uint64_t bytecodeChecksum(const Bytecode& bytecode);
+
+// Writes to a temporary file and renames it over path, so an interrupted
+// write never leaves a torn snapshot behind. Throws runtime_error.
+void writeSnapshot(const string& path, const Bytecode& bytecode, const char* numericName,
+                   const void* slots, size_t valueSize, uint64_t pc, uint64_t statement);
+
+// A snapshot mapped privately: the slots are written in place, copy-on-write,
+// and the file itself never changes. Opening throws runtime_error if the file
+// is malformed, was taken with another numeric backend, or comes from
+// different bytecode.
+class Snapshot {
+public:
+    Snapshot(const string& path, const Bytecode& bytecode, const char* numericName, size_t valueSize);
+    ~Snapshot();
+    Snapshot(const Snapshot&) = delete;
+    Snapshot& operator=(const Snapshot&) = delete;
+
+    void* slots() const { return data + header->slotsOffset; }
+    uint64_t pc() const { return header->pc; }
+    uint64_t statement() const { return header->statement; }
+
+private:
+    uint8_t* data = nullptr;
+    size_t size = 0;
+    const SnapshotHeader* header = nullptr;
+
+    void validate(const Bytecode& bytecode, const char* numericName, size_t valueSize);
+};
+
+#endif
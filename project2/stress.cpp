@@ -0,0 +1,229 @@
+#include <malloc.h>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <vector>
+#include "scanner.hpp"
+#include "parser.hpp"
+
+using namespace std;
+
+// Stress test for the scanner and parser on pathological inputs. Each input
+// class is generated at doubling sizes and scanned and parsed end to end,
+// once from memory and once streamed: the parser pulls tokens from a
+// scanner fed in small blocks, as for compressed input, so long tokens cross
+// many block boundaries. A class fails if its time grows faster than
+// linearly between the smallest and largest size, or if any size exceeds the
+// time budget per MB or the heap budget (peak bytes allocated per input
+// byte). The budgets hold for the default debug build. Diagnostics are
+// discarded so that error-heavy classes measure the compiler, not the
+// terminal.
+
+const double timeBudgetMsPerMB = 600;
+// Derived from the data structures, not fitted to measurements: a byte
+// yields at most one Token and at most one RPNInstruction (every operand
+// and operator is at least one byte), and a growing vector briefly holds
+// its old buffer next to one twice as large, so each can peak at three
+// records per byte. Identifier text adds at most four bytes per byte: the
+// token, its copy while the statement is parsed, the declared-variable set
+// and one RPN operand.
+const double memoryBudgetPerByte = 3 * sizeof(Token) + 3 * sizeof(RPNInstruction) + 4;
+const size_t streamBlockSize = 4096;
+const double maxGrowthExponent = 1.3;
+const double minMeasurableMs = 5;
+
+// Heap use is measured by replacing the global allocator; the harness is
+// single-threaded.
+static size_t liveBytes = 0;
+static size_t peakBytes = 0;
+
+void* operator new(size_t size) {
+    void* block = malloc(size == 0 ? 1 : size);
+    if (block == nullptr) throw bad_alloc();
+    liveBytes += malloc_usable_size(block);
+    if (liveBytes > peakBytes) peakBytes = liveBytes;
+    return block;
+}
+
+void operator delete(void* block) noexcept {
+    if (block == nullptr) return;
+    liveBytes -= malloc_usable_size(block);
+    free(block);
+}
+
+void operator delete(void* block, size_t) noexcept {
+    operator delete(block);
+}
+
+struct InputClass {
+    string name;
+    string (*generate)(size_t bytes);
+};
+
+struct Measurement {
+    size_t bytes;
+    double ms;
+    double heapPerByte;
+};
+
+string longIdentifier(size_t bytes) {
+    string name(bytes / 3, 'a');
+    return "begin\nvar " + name + ";\n" + name + " = " + name + ";\nend.\n";
+}
+
+string digitRun(size_t bytes) {
+    return "begin\nvar x;\nx = " + string(bytes, '9') + ";\nend.\n";
+}
+
+string manyNumbers(size_t bytes) {
+    stringstream source;
+    source << "begin\nvar x;\nx = 0";
+    for (uint64_t i = 0; source.tellp() < static_cast<streamoff>(bytes); i++) {
+        source << " + " << i * 7919;
+    }
+    source << ";\nend.\n";
+    return source.str();
+}
+
+string commentLines(size_t bytes) {
+    string source;
+    while (source.size() < bytes) {
+        source += "~ a comment line that the scanner has to skip\n";
+    }
+    return source + "begin\nvar x;\nx = 1;\nend.\n";
+}
+
+string deepParentheses(size_t bytes) {
+    return "begin\nvar x;\nx = " + string(bytes / 2, '(') + "x" + string(bytes / 2, ')') + ";\nend.\n";
+}
+
+// Parser::error throws, so the parser stops at the first ';' and never
+// reaches synchronize(); this class measures the scanner's diagnostics.
+string unexpectedCharacters(size_t bytes) {
+    string source = "begin\n";
+    while (source.size() < bytes) {
+        source += "@ $ ; # ! ;\n";
+    }
+    return source + "end.\n";
+}
+
+string manyStatements(size_t bytes) {
+    stringstream source;
+    source << "begin\nvar v0;\n";
+    for (int i = 1; source.tellp() < static_cast<streamoff>(bytes) / 2; i++) {
+        source << "var v" << i << ";\n";
+    }
+    for (int i = 1; source.tellp() < static_cast<streamoff>(bytes); i++) {
+        source << "v" << i << " = v" << i - 1 << " * (v" << i << " + 3) / 2;\n";
+    }
+    source << "end.\n";
+    return source.str();
+}
+
+void parseFromMemory(const string& source, ostream& discard) {
+    Scanner scanner(source, discard);
+    vector<Token> tokens = scanner.scanTokens();
+    Parser parser(tokens, ParseMode::Full, discard);
+    parser.parse();
+}
+
+void parseStreamed(const string& source, ostream& discard) {
+    size_t offset = 0;
+    Scanner scanner([&](string& block) {
+        block.assign(source, offset, streamBlockSize);
+        offset += block.size();
+        return !block.empty();
+    }, discard);
+    Parser parser(scanner, ParseMode::Full, discard);
+    parser.parse();
+    // As in main, the input is scanned to the end even when parsing stops
+    // early.
+    vector<Token> rest;
+    while (scanner.scanMore(rest)) rest.clear();
+}
+
+Measurement measure(const string& source, bool streamed, int repetitions) {
+    ostream discard(nullptr);
+    Measurement measurement = {source.size(), 0, 0};
+    for (int i = 0; i < repetitions; i++) {
+        size_t baseline = liveBytes;
+        peakBytes = liveBytes;
+        auto begin = chrono::steady_clock::now();
+        if (streamed) {
+            parseStreamed(source, discard);
+        } else {
+            parseFromMemory(source, discard);
+        }
+        auto end = chrono::steady_clock::now();
+        double ms = chrono::duration<double, milli>(end - begin).count();
+        if (i == 0 || ms < measurement.ms) measurement.ms = ms;
+        measurement.heapPerByte = static_cast<double>(peakBytes - baseline) / source.size();
+    }
+    return measurement;
+}
+
+bool stressClass(const InputClass& inputClass, bool streamed, const vector<size_t>& sizes, int repetitions) {
+    bool ok = true;
+    vector<Measurement> measurements;
+    cout << inputClass.name << (streamed ? " (streamed)" : "") << endl;
+    for (size_t size : sizes) {
+        string source = inputClass.generate(size);
+        Measurement measurement = measure(source, streamed, repetitions);
+        measurements.push_back(measurement);
+
+        double megabytes = measurement.bytes / (1024.0 * 1024.0);
+        double msPerMB = measurement.ms / megabytes;
+        cout << "  " << megabytes << " MB: " << measurement.ms << " ms (" << msPerMB << " ms/MB), "
+             << measurement.heapPerByte << " heap bytes/byte" << endl;
+        if (msPerMB > timeBudgetMsPerMB) {
+            cout << "  FAILED: over the time budget of " << timeBudgetMsPerMB << " ms/MB" << endl;
+            ok = false;
+        }
+        if (measurement.heapPerByte > memoryBudgetPerByte) {
+            cout << "  FAILED: over the heap budget of " << memoryBudgetPerByte << " bytes/byte" << endl;
+            ok = false;
+        }
+    }
+
+    const Measurement& first = measurements.front();
+    const Measurement& last = measurements.back();
+    if (measurements.size() > 1 && last.ms >= minMeasurableMs) {
+        double exponent = log(last.ms / first.ms) / log(static_cast<double>(last.bytes) / first.bytes);
+        cout << "  growth exponent: " << exponent << endl;
+        if (exponent > maxGrowthExponent) {
+            cout << "  FAILED: superlinear growth" << endl;
+            ok = false;
+        }
+    }
+    cout << endl;
+    return ok;
+}
+
+int main(int argc, char* argv[]) {
+    size_t maxMegabytes = argc > 1 ? stoul(argv[1]) : 4;
+    int repetitions = argc > 2 ? stoi(argv[2]) : 3;
+    vector<InputClass> classes = {
+        {"long-identifier", longIdentifier},
+        {"digit-run", digitRun},
+        {"many-numbers", manyNumbers},
+        {"comment-lines", commentLines},
+        {"deep-parentheses", deepParentheses},
+        {"unexpected-characters", unexpectedCharacters},
+        {"many-statements", manyStatements},
+    };
+    vector<size_t> sizes;
+    for (size_t megabytes = 1; megabytes <= maxMegabytes; megabytes *= 2) {
+        sizes.push_back(megabytes * 1024 * 1024);
+    }
+
+    bool ok = true;
+    for (const auto& inputClass : classes) {
+        ok = stressClass(inputClass, false, sizes, repetitions) && ok;
+        ok = stressClass(inputClass, true, sizes, repetitions) && ok;
+    }
+    cout << (ok ? "All classes within budget" : "Some classes exceeded their budget") << endl;
+    return ok ? 0 : 1;
+}